@@ -0,0 +1,12 @@
+#define MAXBATCH   32  // max system calls in one batch() call
+#define NBATCHARG   5  // max arguments to a batched system call
+
+// One system call submitted through batch().
+// The layout mirrors the user stack an ordinary system call sees:
+// num sits where the return address would be, so the kernel's
+// argint() finds args[] at the usual offsets.
+struct batchent {
+  int num;               // system call number (SYS_*)
+  int args[NBATCHARG];   // arguments, in call order
+  int ret;               // result, filled in by the kernel
+};
@@ -0,0 +1,109 @@
+// Tests for the batch() system call.
+#include "types.h"
+#include "user.h"
+#include "syscall.h"
+#include "batch.h"
+
+#define ROUNDS 2000
+
+static struct batchent b[MAXBATCH];
+
+static void
+fill(int num, int n)
+{
+  int i;
+
+  memset(b, 0, sizeof(b));
+  for(i = 0; i < n; i++){
+    b[i].num = num;
+    b[i].ret = -2;
+  }
+}
+
+static int
+testresults(void)
+{
+  static char msg[] = "batch write\n";
+  int n;
+
+  fill(SYS_getpid, 3);
+  b[1].num = SYS_write;
+  b[1].args[0] = 1;
+  b[1].args[1] = (int)msg;
+  b[1].args[2] = sizeof(msg) - 1;
+  n = batch(b, 3);
+  if(n != 3){
+    printf(2, "FAILED: batch ran %d of 3 entries\n", n);
+    return -1;
+  }
+  if(b[0].ret != getpid() || b[2].ret != getpid()){
+    printf(2, "FAILED: getpid in batch returned %d, %d\n", b[0].ret, b[2].ret);
+    return -1;
+  }
+  if(b[1].ret != sizeof(msg) - 1){
+    printf(2, "FAILED: write in batch returned %d\n", b[1].ret);
+    return -1;
+  }
+  return 0;
+}
+
+static int
+testrejects(void)
+{
+  int n;
+
+  fill(SYS_getpid, 3);
+  b[1].num = SYS_fork;
+  n = batch(b, 3);
+  if(n != 1 || b[1].ret != -1 || b[2].ret != -2){
+    printf(2, "FAILED: fork in batch: ran %d, ret %d\n", n, b[1].ret);
+    return -1;
+  }
+  b[1].num = 12345;
+  n = batch(b, 3);
+  if(n != 1 || b[1].ret != -1){
+    printf(2, "FAILED: bad number in batch: ran %d, ret %d\n", n, b[1].ret);
+    return -1;
+  }
+  if(batch(b, MAXBATCH+1) != -1 || batch((struct batchent*)0x7fffffff, 1) != -1){
+    printf(2, "FAILED: bad batch arguments accepted\n");
+    return -1;
+  }
+  return 0;
+}
+
+static void
+timing(void)
+{
+  int i, start, single, batched;
+
+  // sleep(0) returns at once, but unlike getpid() it always traps.
+  start = uptime();
+  for(i = 0; i < ROUNDS*MAXBATCH; i++)
+    sleep(0);
+  single = uptime() - start;
+
+  fill(SYS_sleep, MAXBATCH);
+  start = uptime();
+  for(i = 0; i < ROUNDS; i++)
+    batch(b, MAXBATCH);
+  batched = uptime() - start;
+
+  printf(1, "%d sleep(0) calls: %d ticks one at a time, %d ticks batched\n",
+      ROUNDS*MAXBATCH, single, batched);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fail = 0;
+
+  if(testresults() < 0)
+    fail = 1;
+  if(testrejects() < 0)
+    fail = 1;
+  if(!fail)
+    printf(1, "** batch tests passed! **\n");
+  timing();
+  exit();
+}
@@ -43,10 +43,12 @@ int             filewrite(struct file*, char*, int n);
 // fs.c
 void            readsb(int dev, struct superblock *sb);
 int             dirlink(struct inode*, char*, uint);
+void            dcput(struct inode*, char*, uint, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
+void            fsmount(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
@@ -60,6 +62,20 @@ void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
 
+// fpu.c
+void            fpuinit(void);
+void            fpusave(struct proc*);
+int             fputrap(void);
+void            fpufork(struct proc*, struct proc*);
+void            fpureset(void);
+void            kfpubegin(void);
+void            kfpuend(void);
+
+// futex.c
+void            futexinit(void);
+int             futexwait(uint, int);
+int             futexwake(uint, int);
+
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
@@ -85,6 +101,7 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipiothers(int);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
 
@@ -93,6 +110,7 @@ void            initlog(int dev);
 void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
+void            logflusher(void*);
 
 // mp.c
 extern int      ismp;
@@ -113,8 +131,12 @@ int             pipewrite(struct pipe*, char*, int);
 int             cpuid(void);
 void            exit(void);
 int             fork(void);
-int             growproc(int);
+int             clone(void(*)(void*), void*, void*);
+int             join(void**);
+void            vmrelease(pde_t*);
+int             growproc(int, uint*);
 int             kill(int);
+int             kthread_create(void (*)(void*), void*, char*);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
@@ -170,6 +192,7 @@ char*           safestrcpy(char*, const char*, int);
 int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
+void            stringinit(void);
 
 // syscall.c
 int             argint(int, int*);
@@ -199,6 +222,9 @@ pde_t*          setupkvm(void);
 char*           uva2ka(pde_t*, char*);
 int             allocuvm(pde_t*, uint, uint);
 int             deallocuvm(pde_t*, uint, uint);
+int             shrinkuvm(pde_t*, uint, uint);
+void            tlbshootdown(void);
+void            tlbintr(void);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
@@ -207,6 +233,9 @@ void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+void            setudata(struct proc*);
+void            updatekdata(void);
+void            readkdate(struct rtcdate*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -100,10 +100,12 @@ exec(char *path, char **argv)
   oldpgdir = curproc->pgdir;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
+  curproc->thread = 0;  // no longer shares an address space
+  fpureset();
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
   switchuvm(curproc);
-  freevm(oldpgdir);
+  vmrelease(oldpgdir);
   return 0;
 
 bad:
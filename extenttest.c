@@ -0,0 +1,83 @@
+// Tests for extent-mapped files (O_EXTENT).
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NBLOCKS 1024
+
+static char buf[512];
+
+static int
+writefile(char *name, int mode)
+{
+  int fd, i, start;
+
+  start = uptime();
+  if((fd = open(name, O_CREATE|O_RDWR|mode)) < 0){
+    printf(2, "FAILED: create %s\n", name);
+    return -1;
+  }
+  for(i = 0; i < NBLOCKS; i++){
+    ((int*)buf)[0] = i;
+    ((int*)buf)[127] = ~i;
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(2, "FAILED: write %s block %d\n", name, i);
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  return uptime() - start;
+}
+
+static int
+readfile(char *name)
+{
+  int fd, i, n, start;
+
+  start = uptime();
+  if((fd = open(name, O_RDONLY)) < 0){
+    printf(2, "FAILED: open %s\n", name);
+    return -1;
+  }
+  for(i = 0; (n = read(fd, buf, sizeof(buf))) > 0; i++){
+    if(n != sizeof(buf) || ((int*)buf)[0] != i || ((int*)buf)[127] != ~i){
+      printf(2, "FAILED: %s block %d has the wrong contents\n", name, i);
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  if(i != NBLOCKS){
+    printf(2, "FAILED: read %d of %d blocks of %s\n", i, NBLOCKS, name);
+    return -1;
+  }
+  return uptime() - start;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ew, er, iw, ir;
+
+  ew = writefile("extfile", O_EXTENT);
+  iw = writefile("indfile", 0);
+  er = readfile("extfile");
+  ir = readfile("indfile");
+  if(ew < 0 || iw < 0 || er < 0 || ir < 0)
+    exit();
+
+  // The blocks must be free again for reuse.
+  if(unlink("extfile") < 0 || unlink("indfile") < 0){
+    printf(2, "FAILED: unlink\n");
+    exit();
+  }
+  if(writefile("extfile", O_EXTENT) < 0 || readfile("extfile") < 0)
+    exit();
+  unlink("extfile");
+
+  printf(1, "** extent tests passed! **\n");
+  printf(1, "%d blocks: extents write %d read %d ticks, indirect write %d read %d ticks\n",
+      NBLOCKS, ew, er, iw, ir);
+  exit();
+}
@@ -126,11 +126,12 @@ filewrite(struct file *f, char *addr, int n)
   if(f->type == FD_INODE){
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
+    // i-node, 2 indirect blocks per level of indirection,
+    // allocation blocks, and 2 blocks of slop for
+    // non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+    int max = ((MAXOPBLOCKS-1-2*NLEVEL-2) / 2) * 512;
     int i = 0;
     while(i < n){
       int n1 = n - i;
@@ -144,10 +145,8 @@ filewrite(struct file *f, char *addr, int n)
       iunlock(f->ip);
       end_op();
 
-      if(r < 0)
-        break;
       if(r != n1)
-        panic("short filewrite");
+        break;  // error, or out of extents
       i += r;
     }
     return i == n ? n : -1;
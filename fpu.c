@@ -0,0 +1,106 @@
+// FPU, MMX and SSE state.  The registers are saved and restored
+// lazily: CR0_TS is set whenever they do not hold the running
+// process's state, so its first FPU instruction after a switch
+// raises T_DEVICE and only then does fputrap() load its state.
+// A process that used the FPU during its time slice has its state
+// saved when it gives up the CPU (fpusave), so the state never
+// stays behind in another CPU's registers.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+
+static int fpuon;  // set if the CPU has fxsave/fxrstor
+static char fpuinitstate[512] __attribute__((aligned(16)));
+
+// Enable the FPU and SSE on this CPU.  Run once on entry on each CPU.
+void
+fpuinit(void)
+{
+  uint f;
+
+  f = cpufeatures();
+  if(!(f & CPUID_FXSR))
+    return;  // leave the FPU as the boot code set it up
+  fpuon = 1;
+  lcr0((rcr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+  if(f & CPUID_SSE)
+    lcr4(rcr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+  clts();
+  if(cpuid() == 0){
+    // The state a process starts with on its first FPU instruction.
+    asm volatile("fninit");
+    fxsave(fpuinitstate);
+  }
+  lcr0(rcr0() | CR0_TS);
+}
+
+// Called by sched() for p, which is giving up the CPU.  Save p's
+// FPU state if it used the FPU since it was switched in.
+void
+fpusave(struct proc *p)
+{
+  if(!fpuon || (rcr0() & CR0_TS))
+    return;
+  if(p->state != ZOMBIE)
+    fxsave(p->fpu);
+  lcr0(rcr0() | CR0_TS);
+}
+
+// Handle T_DEVICE from user space: give the FPU to the current
+// process.  Returns -1 if the trap is not ours.
+int
+fputrap(void)
+{
+  struct proc *p = myproc();
+
+  if(!fpuon || p == 0)
+    return -1;
+  clts();
+  fxrstor(p->fpuused ? p->fpu : fpuinitstate);
+  p->fpuused = 1;
+  return 0;
+}
+
+// Let the kernel use the SSE registers until kfpuend(), saving
+// the current process's state first if it is in them.  Interrupts
+// stay off in between, so nothing else can see the kernel's values.
+void
+kfpubegin(void)
+{
+  pushcli();
+  if(!(rcr0() & CR0_TS))
+    fxsave(myproc()->fpu);
+  clts();
+}
+
+void
+kfpuend(void)
+{
+  lcr0(rcr0() | CR0_TS);
+  popcli();
+}
+
+// Give the new process np a copy of p's FPU state.
+void
+fpufork(struct proc *np, struct proc *p)
+{
+  if(fpuon && !(rcr0() & CR0_TS))
+    fxsave(p->fpu);
+  np->fpuused = p->fpuused;
+  if(np->fpuused)
+    memmove(np->fpu, p->fpu, sizeof(np->fpu));
+}
+
+// exec() starts the current process over with a fresh FPU.
+void
+fpureset(void)
+{
+  myproc()->fpuused = 0;
+  if(fpuon)
+    lcr0(rcr0() | CR0_TS);
+}
@@ -0,0 +1,100 @@
+// Tests that FPU and SSE registers survive context switches.
+#include "types.h"
+#include "user.h"
+
+#define NCHILD 4
+#define ROUNDS 200
+
+// Load v, v+1, v+2, v+3 into %xmm0, sleep so other
+// processes get the CPU, and check %xmm0 is unchanged.
+static int
+ssecheck(uint v)
+{
+  uint in[4];
+  uint out[4];
+  int i;
+
+  for(i = 0; i < 4; i++)
+    in[i] = v + i;
+  asm volatile("movdqu %0, %%xmm0" : : "m" (in));
+  sleep(1);
+  asm volatile("movdqu %%xmm0, %0" : "=m" (out));
+  for(i = 0; i < 4; i++)
+    if(out[i] != in[i])
+      return -1;
+  return 0;
+}
+
+// Sum 1/k for k=1..n with x87 arithmetic, switching along the way.
+static double
+harmonic(int n)
+{
+  double sum;
+  int k;
+
+  sum = 0;
+  for(k = 1; k <= n; k++){
+    sum += 1.0 / k;
+    if(k % 100 == 0)
+      sleep(1);
+  }
+  return sum;
+}
+
+// Report success by writing a byte to fd.
+static void
+child(int id, int fd)
+{
+  double h, want;
+  int i;
+
+  for(i = 0; i < ROUNDS; i++){
+    if(ssecheck(id * 0x10000 + i) < 0){
+      printf(2, "FAILED: child %d lost %%xmm0 in round %d\n", id, i);
+      exit();
+    }
+  }
+  want = harmonic(1000);
+  for(i = 0; i < 10; i++){
+    if((h = harmonic(1000)) != want){
+      printf(2, "FAILED: child %d harmonic sum changed\n", id);
+      exit();
+    }
+  }
+  if((int)(want * 1000) != 7485){
+    printf(2, "FAILED: child %d harmonic sum %d/1000\n", id, (int)(want * 1000));
+    exit();
+  }
+  write(fd, "y", 1);
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, pid, p[2];
+  char buf[NCHILD+1];
+
+  if(pipe(p) < 0){
+    printf(2, "FAILED: pipe\n");
+    exit();
+  }
+  for(i = 0; i < NCHILD; i++){
+    if((pid = fork()) < 0){
+      printf(2, "FAILED: fork\n");
+      exit();
+    }
+    if(pid == 0){
+      close(p[0]);
+      child(i+1, p[1]);
+    }
+  }
+  close(p[1]);
+  for(i = 0; i < NCHILD; i++)
+    wait();
+  n = read(p[0], buf, sizeof(buf));
+  close(p[0]);
+  if(n == NCHILD)
+    printf(1, "** fpu tests passed! **\n");
+  exit();
+}
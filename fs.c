@@ -23,6 +23,9 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
+static void dcinit(void);
+static void dcpurge(struct inode*);
+static void ifreeinit(int dev);
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb;
@@ -52,31 +55,104 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// In-memory summary of the free bitmap, built by fsmount().
+// nfree[i] counts the free blocks that bitmap block i covers;
+// it is only changed while holding that bitmap block's buffer,
+// so it needs no lock of its own. The cursor, where searches
+// without a goal start, is only a hint.
+#define NBMAP (FSSIZE/BPB + 1)
+static struct {
+  int nfree[NBMAP];
+  uint cursor;
+} bsum;
+
+// Return the first bit at or after bi in bitmap block bp,
+// which covers blocks b to b+BPB-1, that starts a run of n
+// free blocks inside that bitmap block, or -1.
+// Skips whole words that are in use.
+static int
+bfindrun(struct buf *bp, uint b, int bi, int n)
+{
+  uint *w = (uint*)bp->data;
+  int run, end;
+
+  end = BPB;
+  if(b + end > sb.size)
+    end = sb.size - b;
+  for(run = 0; bi < end; bi++){
+    if(bi%32 == 0 && w[bi/32] == ~0U){
+      run = 0;
+      bi += 31;
+    } else if(w[bi/32] & (1 << (bi%32)))
+      run = 0;
+    else if(++run == n)
+      return bi - n + 1;
+  }
+  return -1;
+}
+
+// Mark block b+bi, bit bi of bitmap block bp, in use.
+// Release bp and return the zeroed block.
 static uint
-balloc(uint dev)
+btake(uint dev, struct buf *bp, uint b, int bi)
+{
+  bp->data[bi/8] |= 1 << (bi % 8);  // Mark block in use.
+  bsum.nfree[b/BPB]--;
+  bsum.cursor = b + bi + 1;
+  log_write(bp);
+  brelse(bp);
+  bzero(dev, b + bi);
+  return b + bi;
+}
+
+// Allocate a zeroed disk block: goal if it is free, else the
+// start of the first run of n free blocks after goal, settling
+// for shorter runs when there is none. With no goal, search
+// from the allocation cursor.
+static uint
+ballocnear(uint dev, uint goal, int n)
 {
-  int b, bi, m;
+  int b, bi, i;
+  uint start;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
+  if(goal >= sb.size)
+    goal = 0;
+  if(goal != 0){
+    bp = bread(dev, BBLOCK(goal, sb));
+    bi = goal % BPB;
+    if((bp->data[bi/8] & (1 << (bi % 8))) == 0)  // Is goal free?
+      return btake(dev, bp, goal - bi, bi);
+    brelse(bp);
+    start = goal;
+  } else if((start = bsum.cursor) >= sb.size)
+    start = 0;
+  for(; n > 0; n /= 2){
+    b = start - start % BPB;
+    bi = start % BPB;
+    // One extra step comes back round to the start of start's block.
+    for(i = 0; i <= (sb.size + BPB - 1) / BPB; i++){
+      if(bsum.nfree[b/BPB] >= n){
+        bp = bread(dev, BBLOCK(b, sb));
+        if((bi = bfindrun(bp, b, bi, n)) >= 0)
+          return btake(dev, bp, b, bi);
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
       }
+      if((b += BPB) >= sb.size)
+        b = 0;
+      bi = 0;
     }
-    brelse(bp);
   }
   panic("balloc: out of blocks");
 }
 
+// Allocate a zeroed disk block.
+static uint
+balloc(uint dev)
+{
+  return ballocnear(dev, 0, 1);
+}
+
 // Free a disk block.
 static void
 bfree(int dev, uint b)
@@ -84,17 +160,40 @@ bfree(int dev, uint b)
   struct buf *bp;
   int bi, m;
 
-  readsb(dev, &sb);
   bp = bread(dev, BBLOCK(b, sb));
   bi = b % BPB;
   m = 1 << (bi % 8);
   if((bp->data[bi/8] & m) == 0)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
+  bsum.nfree[b/BPB]++;
   log_write(bp);
   brelse(bp);
 }
 
+// Build the in-memory allocation summaries for dev.
+// Called once the log has been recovered.
+void
+fsmount(int dev)
+{
+  struct buf *bp;
+  int b, bi, end;
+
+  if(sb.size > NBMAP*BPB)
+    panic("fsmount: bitmap too big");
+  for(b = 0; b < sb.size; b += BPB){
+    bp = bread(dev, BBLOCK(b, sb));
+    end = sb.size - b < BPB ? sb.size - b : BPB;
+    bsum.nfree[b/BPB] = 0;
+    for(bi = 0; bi < end; bi++)
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        bsum.nfree[b/BPB]++;
+    brelse(bp);
+  }
+  bsum.cursor = 0;
+  ifreeinit(dev);
+}
+
 // Inodes.
 //
 // An inode describes a single unnamed file.
@@ -120,18 +219,21 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
+// * Referencing in cache: ip->ref tracks the number of
+//   in-memory pointers to the entry (open files and current
+//   directories). iget() finds (through a hash table) or
 //   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+//   decrements ref. An entry whose ref is zero stays cached,
+//   on an LRU list, until iget() recycles it for another
+//   inode. The cache grows a page of entries at a time when
+//   every entry is referenced.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
 //   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ip->valid if it frees the inode, and iget() when it
+//   recycles the entry.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -158,26 +260,72 @@ bfree(int dev, uint b)
 // The icache.lock spin-lock protects the allocation of icache
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// holds, one must hold icache.lock while using any of those
+// fields, or the hash and LRU links.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 61
+
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+  struct inode lru;  // unreferenced entries; lru.next is the oldest
 } icache;
 
+// Append ip to the LRU list of unreferenced entries.
+static void
+ilruadd(struct inode *ip)
+{
+  ip->prev = icache.lru.prev;
+  ip->next = &icache.lru;
+  icache.lru.prev->next = ip;
+  icache.lru.prev = ip;
+}
+
+static void
+ilrudel(struct inode *ip)
+{
+  ip->prev->next = ip->next;
+  ip->next->prev = ip->prev;
+}
+
+static uint
+ihash(uint dev, uint inum)
+{
+  return (dev*31 + inum) % NIHASH;
+}
+
+// Add a page of fresh entries to the cache.
+static void
+igrow(void)
+{
+  struct inode *ip, *end;
+
+  if((ip = (struct inode*)kalloc()) == 0)
+    panic("iget: no inodes");
+  memset(ip, 0, PGSIZE);
+  for(end = ip + PGSIZE/sizeof(*ip); ip < end; ip++){
+    initsleeplock(&ip->lock, "inode");
+    ilruadd(ip);
+  }
+}
+
 void
 iinit(int dev)
 {
   int i = 0;
 
   initlock(&icache.lock, "icache");
+  icache.lru.prev = icache.lru.next = &icache.lru;
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&icache.inode[i].lock, "inode");
+    ilruadd(&icache.inode[i]);
   }
+  dcinit();
 
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
@@ -189,6 +337,69 @@ iinit(int dev)
 static struct inode* iget(uint dev, uint inum);
 
 //PAGEBREAK!
+// Free-inode hints, built by fsmount() from the inode blocks:
+// bit i of free[] is set if inode i is free. ialloc() claims a
+// hinted inode starting at the cursor and checks it on disk;
+// iput() sets the bit again when it frees an inode.
+#define NIFREE 1024  // most inodes a file system may have
+
+static struct {
+  struct spinlock lock;
+  uint free[NIFREE/32];
+  uint cursor;
+} ifree;
+
+static void
+ifreeinit(int dev)
+{
+  struct buf *bp;
+  struct dinode *dip;
+  uint inum;
+
+  if(sb.ninodes > NIFREE)
+    panic("fsmount: too many inodes");
+  initlock(&ifree.lock, "ifree");
+  memset(ifree.free, 0, sizeof(ifree.free));
+  for(inum = 1; inum < sb.ninodes; inum++){
+    bp = bread(dev, IBLOCK(inum, sb));
+    dip = (struct dinode*)bp->data + inum%IPB;
+    if(dip->type == 0)
+      ifree.free[inum/32] |= 1 << (inum%32);
+    brelse(bp);
+  }
+  ifree.cursor = 1;
+}
+
+// Claim a free inode number from the hints, or return 0.
+static uint
+ifreetake(void)
+{
+  uint i, w, inum;
+
+  acquire(&ifree.lock);
+  w = (ifree.cursor/32) % (NIFREE/32);  // cursor may be NIFREE
+  for(i = 0; i <= NIFREE/32; i++, w = (w+1) % (NIFREE/32)){
+    if(ifree.free[w] == 0)
+      continue;
+    for(inum = w*32; (ifree.free[w] & (1 << (inum%32))) == 0; inum++)
+      ;
+    ifree.free[w] &= ~(1 << (inum%32));
+    ifree.cursor = inum + 1;
+    release(&ifree.lock);
+    return inum;
+  }
+  release(&ifree.lock);
+  return 0;
+}
+
+static void
+ifreeput(uint inum)
+{
+  acquire(&ifree.lock);
+  ifree.free[inum/32] |= 1 << (inum%32);
+  release(&ifree.lock);
+}
+
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
 // Returns an unlocked but allocated and referenced inode.
@@ -199,7 +410,7 @@ ialloc(uint dev, short type)
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
+  while((inum = ifreetake()) != 0){
     bp = bread(dev, IBLOCK(inum, sb));
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
@@ -209,7 +420,7 @@ ialloc(uint dev, short type)
       brelse(bp);
       return iget(dev, inum);
     }
-    brelse(bp);
+    brelse(bp);  // stale hint
   }
   panic("ialloc: no inodes");
 }
@@ -242,31 +453,37 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **pp;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = icache.hash[ihash(dev, inum)]; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0)
+        ilrudel(ip);
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
-    panic("iget: no inodes");
+  // Recycle the least recently used entry.
+  if(icache.lru.next == &icache.lru)
+    igrow();
+  ip = icache.lru.next;
+  ilrudel(ip);
+  if(ip->inum != 0){
+    for(pp = &icache.hash[ihash(ip->dev, ip->inum)]; *pp != ip; pp = &(*pp)->hnext)
+      ;
+    *pp = ip->hnext;
+  }
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = icache.hash[ihash(dev, inum)];
+  icache.hash[ihash(dev, inum)] = ip;
   release(&icache.lock);
 
   return ip;
@@ -339,16 +556,20 @@ iput(struct inode *ip)
     release(&icache.lock);
     if(r == 1){
       // inode has no links and no other references: truncate and free.
+      if(ip->type == T_DIR)
+        dcpurge(ip);
       itrunc(ip);
       ip->type = 0;
       iupdate(ip);
       ip->valid = 0;
+      ifreeput(ip->inum);
     }
   }
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(--ip->ref == 0)
+    ilruadd(ip);  // stays cached until recycled
   release(&icache.lock);
 }
 
@@ -366,16 +587,108 @@ iunlockput(struct inode *ip)
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// listed in block ip->addrs[NDIRECT], the NINDIRECT^2 after
+// that in the double-indirect tree at ip->addrs[NDIRECT+1],
+// and the NINDIRECT^3 after that in the triple-indirect tree
+// at ip->addrs[NDIRECT+2].
+
+#define ISEXTENT(ip) ((ip)->type == T_FILE && (ip)->minor == IF_EXTENT)
+
+// Return the disk block address of the nth block in
+// extent-mapped inode ip. Blocks are only ever added just past
+// the last mapped block; extend the last extent if the next
+// disk block is free, else start a new extent. Return 0 if
+// that needs an extent and all are in use.
+static uint
+emap(struct inode *ip, uint bn)
+{
+  uint *e, *last, lbn, addr, goal;
+  struct buf *bp;
+  int i;
+
+  bp = 0;
+  last = 0;
+  lbn = 0;
+  e = ip->addrs;
+  for(i = 0; i < NDEXTENT+NIEXTENT; i++, e += 2){
+    if(i == NDEXTENT){
+      if(ip->addrs[NDEXTENT*2] == 0)
+        ip->addrs[NDEXTENT*2] = balloc(ip->dev);
+      bp = bread(ip->dev, ip->addrs[NDEXTENT*2]);
+      e = (uint*)bp->data;
+    }
+    if(e[1] == 0)
+      break;
+    if(bn < lbn + e[1]){
+      addr = e[0] + bn - lbn;
+      goto out;
+    }
+    lbn += e[1];
+    last = e;
+  }
+
+  if(bn != lbn)
+    panic("emap: hole");
+  goal = last ? last[0] + last[1] : 0;
+  addr = ballocnear(ip->dev, goal, EXTRUN);
+  if(last && addr == goal)
+    last[1]++;
+  else if(i < NDEXTENT+NIEXTENT){
+    e[0] = addr;
+    e[1] = 1;
+  } else {
+    bfree(ip->dev, addr);
+    addr = 0;
+  }
+  if(bp && addr)
+    log_write(bp);
+out:
+  if(bp)
+    brelse(bp);
+  return addr;
+}
+
+// Free the blocks of extent-mapped inode ip.
+static void
+efree(struct inode *ip)
+{
+  uint *e, b;
+  struct buf *bp;
+  int i;
+
+  bp = 0;
+  e = ip->addrs;
+  for(i = 0; i < NDEXTENT+NIEXTENT; i++, e += 2){
+    if(i == NDEXTENT){
+      if(ip->addrs[NDEXTENT*2] == 0)
+        break;
+      bp = bread(ip->dev, ip->addrs[NDEXTENT*2]);
+      e = (uint*)bp->data;
+    }
+    if(e[1] == 0)
+      break;
+    for(b = e[0]; b < e[0] + e[1]; b++)
+      bfree(ip->dev, b);
+  }
+  if(bp){
+    brelse(bp);
+    bfree(ip->dev, ip->addrs[NDEXTENT*2]);
+  }
+  memset(ip->addrs, 0, sizeof(ip->addrs));
+}
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
 static uint
 bmap(struct inode *ip, uint bn)
 {
-  uint addr, *a;
+  uint addr, *a, n;
+  int level;
   struct buf *bp;
 
+  if(ISEXTENT(ip))
+    return emap(ip, bn);
+
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
       ip->addrs[bn] = addr = balloc(ip->dev);
@@ -383,21 +696,52 @@ bmap(struct inode *ip, uint bn)
   }
   bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+  // Find the tree holding bn; it maps n blocks.
+  n = NINDIRECT;
+  for(level = 0; bn >= n; level++){
+    if(level == NLEVEL-1)
+      panic("bmap: out of range");
+    bn -= n;
+    n *= NINDIRECT;
+  }
+
+  // Walk down the indirect blocks, allocating if necessary.
+  if((addr = ip->addrs[NDIRECT+level]) == 0)
+    ip->addrs[NDIRECT+level] = addr = balloc(ip->dev);
+  while(n > 1){
+    n /= NINDIRECT;
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+    if((addr = a[bn/n]) == 0){
+      a[bn/n] = addr = balloc(ip->dev);
       log_write(bp);
     }
     brelse(bp);
-    return addr;
+    bn %= n;
   }
+  return addr;
+}
 
-  panic("bmap: out of range");
+// Free indirect block addr and, level deep, the blocks below it.
+static void
+bfreeind(uint dev, uint addr, int level)
+{
+  struct buf *bp;
+  uint *a;
+  int j;
+
+  bp = bread(dev, addr);
+  a = (uint*)bp->data;
+  for(j = 0; j < NINDIRECT; j++){
+    if(a[j] == 0)
+      continue;
+    if(level > 0)
+      bfreeind(dev, a[j], level-1);
+    else
+      bfree(dev, a[j]);
+  }
+  brelse(bp);
+  bfree(dev, addr);
 }
 
 // Truncate inode (discard contents).
@@ -408,9 +752,10 @@ bmap(struct inode *ip, uint bn)
 static void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i;
+
+  if(ISEXTENT(ip))
+    efree(ip);
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
@@ -419,16 +764,11 @@ itrunc(struct inode *ip)
     }
   }
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
+  for(i = 0; i < NLEVEL; i++){
+    if(ip->addrs[NDIRECT+i]){
+      bfreeind(ip->dev, ip->addrs[NDIRECT+i], i);
+      ip->addrs[NDIRECT+i] = 0;
     }
-    brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
   }
 
   ip->size = 0;
@@ -482,7 +822,7 @@ readi(struct inode *ip, char *dst, uint off, uint n)
 int
 writei(struct inode *ip, char *src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -497,18 +837,20 @@ writei(struct inode *ip, char *src, uint off, uint n)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    if((addr = bmap(ip, off/BSIZE)) == 0)
+      break;  // out of extents
+    bp = bread(ip->dev, addr);
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
     log_write(bp);
     brelse(bp);
   }
 
-  if(n > 0 && off > ip->size){
+  if(tot > 0 && off > ip->size){
     ip->size = off;
     iupdate(ip);
   }
-  return n;
+  return tot;
 }
 
 //PAGEBREAK!
@@ -520,32 +862,306 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Directory name cache.
+//
+// dirlookup() first consults a cache mapping (directory, name) to
+// the inode number and offset of the matching entry, or to "no
+// such entry" (inum 0), and only scans the directory on a miss.
+// Everyone who reads or writes directory entries holds the
+// directory's sleep-lock, and the writers (dirlink() and
+// sys_unlink()) update the cache via dcput(), so a hit is always
+// current. dcache.lock protects the table itself, since different
+// directories are locked independently.
+#define NDCHASH 61
+
+struct dcent {
+  uint dev;
+  uint dinum;            // directory inode number, 0 if unused
+  char name[DIRSIZ];
+  uint inum;             // entry's inode number, 0 if no such entry
+  uint off;              // byte offset of the entry in the directory
+  struct dcent *hnext;   // hash chain
+  struct dcent *prev;    // LRU list
+  struct dcent *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct dcent ent[NDCACHE];
+  struct dcent *hash[NDCHASH];
+
+  // Linked list of all entries, through prev/next.
+  // head.next is most recently used.
+  struct dcent head;
+} dcache;
+
+static void
+dcinit(void)
+{
+  struct dcent *e;
+
+  initlock(&dcache.lock, "dcache");
+  dcache.head.prev = &dcache.head;
+  dcache.head.next = &dcache.head;
+  for(e = dcache.ent; e < dcache.ent+NDCACHE; e++){
+    e->next = dcache.head.next;
+    e->prev = &dcache.head;
+    dcache.head.next->prev = e;
+    dcache.head.next = e;
+  }
+}
+
+static uint
+dchash(uint dev, uint dinum, char *name)
+{
+  return (dirhash(name) + dinum*31 + dev) % NDCHASH;
+}
+
+// Move e to the front (front != 0) or back of the LRU list.
+// Caller must hold dcache.lock.
+static void
+dcmove(struct dcent *e, int front)
+{
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+  if(front){
+    e->next = dcache.head.next;
+    e->prev = &dcache.head;
+  } else {
+    e->next = &dcache.head;
+    e->prev = dcache.head.prev;
+  }
+  e->next->prev = e;
+  e->prev->next = e;
+}
+
+// Remove e from its hash chain. Caller must hold dcache.lock.
+static void
+dcunhash(struct dcent *e)
+{
+  struct dcent **pp;
+
+  for(pp = &dcache.hash[dchash(e->dev, e->dinum, e->name)]; *pp; pp = &(*pp)->hnext){
+    if(*pp == e){
+      *pp = e->hnext;
+      break;
+    }
+  }
+  e->dinum = 0;
+}
+
+// Return the cache entry for name in directory dev/dinum, or 0.
+// Caller must hold dcache.lock.
+static struct dcent*
+dcfind(uint dev, uint dinum, char *name)
+{
+  struct dcent *e;
+
+  for(e = dcache.hash[dchash(dev, dinum, name)]; e; e = e->hnext)
+    if(e->dev == dev && e->dinum == dinum && namecmp(e->name, name) == 0)
+      return e;
+  return 0;
+}
+
+// Look name up in the cache for directory dp.
+// On a hit, set *pinum (0 if name is known to be absent)
+// and *poff, and return 1. Return 0 on a miss.
+static int
+dclookup(struct inode *dp, char *name, uint *pinum, uint *poff)
+{
+  struct dcent *e;
+
+  acquire(&dcache.lock);
+  if((e = dcfind(dp->dev, dp->inum, name)) == 0){
+    release(&dcache.lock);
+    return 0;
+  }
+  dcmove(e, 1);
+  *pinum = e->inum;
+  *poff = e->off;
+  release(&dcache.lock);
+  return 1;
+}
+
+// Record that name in directory dp refers to inode inum at
+// offset off, or with inum 0 that there is no such entry.
+// Caller must hold dp->lock.
+void
+dcput(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dcent *e;
+
+  acquire(&dcache.lock);
+  if((e = dcfind(dp->dev, dp->inum, name)) == 0){
+    // Recycle the least recently used entry.
+    e = dcache.head.prev;
+    if(e->dinum)
+      dcunhash(e);
+    e->dev = dp->dev;
+    e->dinum = dp->inum;
+    strncpy(e->name, name, DIRSIZ);
+    e->hnext = dcache.hash[dchash(e->dev, e->dinum, e->name)];
+    dcache.hash[dchash(e->dev, e->dinum, e->name)] = e;
+  }
+  e->inum = inum;
+  e->off = off;
+  dcmove(e, 1);
+  release(&dcache.lock);
+}
+
+// Forget everything cached about directory dp, which is being
+// freed (its inode number may be reused) or whose entries have
+// moved.
+static void
+dcpurge(struct inode *dp)
+{
+  struct dcent *e;
+
+  acquire(&dcache.lock);
+  for(e = dcache.ent; e < dcache.ent+NDCACHE; e++){
+    if(e->dinum == dp->inum && e->dev == dp->dev){
+      dcunhash(e);
+      dcmove(e, 0);
+    }
+  }
+  release(&dcache.lock);
+}
+
+// Search the entries of dp from byte offset off up to end for
+// name, or for a free slot if name is 0, a block at a time.
+// Return the offset of the entry, setting *pinum, or -1.
+static int
+dirscan(struct inode *dp, char *name, uint off, uint end, uint *pinum)
+{
+  struct buf *bp;
+  struct dirent *de;
+
+  if(end > dp->size)
+    end = dp->size;
+  while(off < end){
+    bp = bread(dp->dev, bmap(dp, off/BSIZE));
+    do {
+      de = (struct dirent*)(bp->data + off%BSIZE);
+      if(name ? de->inum != 0 && namecmp(name, de->name) == 0 : de->inum == 0){
+        *pinum = de->inum;
+        brelse(bp);
+        return off;
+      }
+      off += sizeof(*de);
+    } while(off < end && off%BSIZE != 0);
+    brelse(bp);
+  }
+  return -1;
+}
+
+// Find the entry for name in dp, or a free slot if name is 0.
+// Linear directories are searched from the start; hashed ones
+// (see fs.h) in name's bucket and then the overflow blocks.
+static int
+dirfind(struct inode *dp, char *name, char *hname, uint *pinum)
+{
+  uint b;
+  int off;
+
+  if(dp->minor == 0)
+    return dirscan(dp, name, 0, dp->size, pinum);
+  b = dirbucket(dirhash(hname), dp->minor);
+  if((off = dirscan(dp, name, b*BSIZE, (b+1)*BSIZE, pinum)) >= 0)
+    return off;
+  return dirscan(dp, name, dp->minor*BSIZE, dp->size, pinum);
+}
+
+#define DPB (BSIZE / sizeof(struct dirent))
+
+// Add a bucket to hashed directory dp by splitting bucket s into
+// s and n, the new last bucket. Block n may be the first overflow
+// block; its entries that do not belong in bucket n move to the
+// end of the directory. Writes at most a few blocks, so it fits
+// in the caller's transaction. Caller must hold dp->lock.
+static void
+dirsplit(struct inode *dp)
+{
+  struct dirent moved[DPB], *de, *nde, *end;
+  struct buf *bs, *bn;
+  uint n, m, s, i, j, nmoved;
+
+  n = dp->minor;
+  if(n == 0 || n >= MAXDIRBUCKET)
+    return;
+  for(m = 1; m*2 <= n; m *= 2)
+    ;
+  s = n - m;
+
+  bn = bread(dp->dev, bmap(dp, n));
+  nmoved = 0;
+  for(i = 0; i < DPB && n*BSIZE + i*sizeof(*de) < dp->size; i++){
+    de = (struct dirent*)bn->data + i;
+    if(de->inum != 0)
+      moved[nmoved++] = *de;
+  }
+  memset(bn->data, 0, BSIZE);
+
+  // Entries of bucket s that now hash to n.
+  nde = (struct dirent*)bn->data;
+  end = nde + DPB;
+  bs = bread(dp->dev, bmap(dp, s));
+  for(de = (struct dirent*)bs->data; de < (struct dirent*)bs->data + DPB; de++){
+    if(de->inum != 0 && dirbucket(dirhash(de->name), n+1) == n){
+      *nde++ = *de;
+      memset(de, 0, sizeof(*de));
+    }
+  }
+  // Overflow entries from block n that hash to n stay there.
+  for(i = j = 0; i < nmoved; i++){
+    if(nde < end && dirbucket(dirhash(moved[i].name), n+1) == n)
+      *nde++ = moved[i];
+    else
+      moved[j++] = moved[i];
+  }
+  nmoved = j;
+  log_write(bs);
+  log_write(bn);
+  brelse(bs);
+  brelse(bn);
+
+  if(dp->size < (n+1)*BSIZE)
+    dp->size = (n+1)*BSIZE;
+  dp->minor = n+1;
+  iupdate(dp);
+  for(i = 0; i < nmoved; i++)
+    if(writei(dp, (char*)&moved[i], dp->size, sizeof(moved[i])) != sizeof(moved[i]))
+      panic("dirsplit");
+  dcpurge(dp);
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
-  uint off, inum;
-  struct dirent de;
+  uint inum, off;
+  int r;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlookup read");
-    if(de.inum == 0)
-      continue;
-    if(namecmp(name, de.name) == 0){
-      // entry matches path element
-      if(poff)
-        *poff = off;
-      inum = de.inum;
-      return iget(dp->dev, inum);
-    }
+  if(dclookup(dp, name, &inum, &off)){
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
   }
 
-  return 0;
+  if((r = dirfind(dp, name, name, &inum)) < 0){
+    dcput(dp, name, 0, 0);
+    return 0;
+  }
+  // entry matches path element
+  if(poff)
+    *poff = r;
+  dcput(dp, name, inum, r);
+  return iget(dp->dev, inum);
 }
 
 // Write a new directory entry (name, inum) into the directory dp.
@@ -553,6 +1169,7 @@ int
 dirlink(struct inode *dp, char *name, uint inum)
 {
   int off;
+  uint unused;
   struct dirent de;
   struct inode *ip;
 
@@ -562,18 +1179,19 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
-  // Look for an empty dirent.
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlink read");
-    if(de.inum == 0)
-      break;
-  }
+  // Look for an empty dirent, else append.
+  if((off = dirfind(dp, 0, name, &unused)) < 0)
+    off = dp->size;
 
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("dirlink");
+  dcput(dp, name, inum, off);
+
+  // Name's bucket was full: grow the hash table by a bucket.
+  if(dp->minor != 0 && off >= dp->minor*BSIZE)
+    dirsplit(dp);
 
   return 0;
 }
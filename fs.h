@@ -21,21 +21,33 @@ struct superblock {
   uint bmapstart;    // Block number of first free map block
 };
 
-#define NDIRECT 12
+#define NDIRECT 10
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NLEVEL 3  // single, double and triple indirect
+#define MAXFILE (NDIRECT + NINDIRECT + NINDIRECT*NINDIRECT + \
+                 NINDIRECT*NINDIRECT*NINDIRECT)
 
 
 // On-disk inode structure
 struct dinode {
   short type;           // File type
   short major;          // Major device number (T_DEV only)
-  short minor;          // Minor device number (T_DEV only)
+  short minor;          // Minor device number (T_DEV only),
+                        // or hash buckets (hashed T_DIR only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint addrs[NDIRECT+NLEVEL];   // Data block addresses or extents
 };
 
+// A T_FILE whose minor is IF_EXTENT is mapped by extents
+// instead: addrs[] holds NDEXTENT (start, length) pairs and
+// then the address of a block holding NIEXTENT more. The used
+// extents come first, in file order.
+#define IF_EXTENT 1
+#define NDEXTENT ((NDIRECT+NLEVEL-1)/2)
+#define NIEXTENT (BSIZE / (2*sizeof(uint)))
+#define EXTRUN 8  // free run wanted when starting a new extent
+
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
 
@@ -56,3 +68,41 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// A hashed directory (one whose inode has minor != 0) keeps the
+// entry for name in block dirbucket(dirhash(name), minor) when
+// that block has room, and otherwise in the overflow blocks that
+// follow the buckets. "." and ".." are always the first two
+// entries of block 0. The contents are still a plain array of
+// dirents. The kernel adds buckets one at a time as the directory
+// grows (linear hashing, see dirsplit() in fs.c).
+#define MAXDIRBUCKET 0x7fff  // minor is a short
+
+static inline uint
+dirhash(const char *name)
+{
+  uint h;
+  int i;
+
+  if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+    return 0;
+  h = 0;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h*31 + (uchar)name[i];
+  return h;
+}
+
+// Bucket for hash h in a directory with n buckets. With
+// m <= n < 2m a power of two, buckets below n-m have been split
+// in two, into b and b+m.
+static inline uint
+dirbucket(uint h, uint n)
+{
+  uint m;
+
+  for(m = 1; m*2 <= n; m *= 2)
+    ;
+  if(h % m < n - m)
+    return h % (2*m);
+  return h % m;
+}
+
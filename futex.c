@@ -0,0 +1,110 @@
+// Futexes: let user code sleep until another thread or process
+// changes a word of memory. Waiters queue in a hash table keyed
+// by the word's physical address, so processes sharing memory
+// through clone() (or any other mapping of the same page) meet
+// in the same queue.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+
+#define NFUTEXHASH 31
+
+// A waiter lives on its process's kernel stack while it sleeps.
+struct fwaiter {
+  uint key;               // physical address of the word
+  int woken;
+  struct fwaiter *next;   // hash chain, oldest first
+};
+
+static struct {
+  struct spinlock lock;
+  struct fwaiter *hash[NFUTEXHASH];
+} futex;
+
+void
+futexinit(void)
+{
+  initlock(&futex.lock, "futex");
+}
+
+// Return the physical address of the user word at addr, or 0.
+static uint
+futexkey(uint addr)
+{
+  struct proc *curproc = myproc();
+  char *ka;
+
+  if(addr % 4 != 0 || addr >= curproc->sz || addr + 4 > curproc->sz)
+    return 0;
+  if((ka = uva2ka(curproc->pgdir, (char*)addr)) == 0)
+    return 0;
+  return V2P(ka) + addr % PGSIZE;
+}
+
+// If the word at addr still holds val, sleep until
+// futexwake() on the same word wakes us. Return 0 once
+// woken, or -1 if the word differs or we were killed.
+int
+futexwait(uint addr, int val)
+{
+  struct fwaiter w, **pp;
+  uint key;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+
+  acquire(&futex.lock);
+  if(*(int*)P2V(key) != val){
+    release(&futex.lock);
+    return -1;
+  }
+  w.key = key;
+  w.woken = 0;
+  w.next = 0;
+  for(pp = &futex.hash[key % NFUTEXHASH]; *pp; pp = &(*pp)->next)
+    ;
+  *pp = &w;
+  while(!w.woken && !myproc()->killed)
+    sleep(&w, &futex.lock);
+  if(!w.woken){
+    for(pp = &futex.hash[key % NFUTEXHASH]; *pp != &w; pp = &(*pp)->next)
+      ;
+    *pp = w.next;
+  }
+  release(&futex.lock);
+  return w.woken ? 0 : -1;
+}
+
+// Wake up to n processes waiting on the word at addr, oldest
+// first. Return how many were woken, or -1.
+int
+futexwake(uint addr, int n)
+{
+  struct fwaiter *w, **pp;
+  uint key;
+  int woken;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+
+  woken = 0;
+  acquire(&futex.lock);
+  pp = &futex.hash[key % NFUTEXHASH];
+  while((w = *pp) != 0 && woken < n){
+    if(w->key != key){
+      pp = &w->next;
+      continue;
+    }
+    *pp = w->next;
+    w->woken = 1;
+    wakeup(w);
+    woken++;
+  }
+  release(&futex.lock);
+  return woken;
+}
@@ -1,107 +1,630 @@
-// Simple grep.  Only supports ^ . * $ operators.
+// Simple grep.  Patterns are regular expressions built from
+// c . [abc] [^a-z] \c (e) e* e+ e? e|e, with a leading ^ and a
+// trailing $ anchoring the match to the start and end of the line.
+// A pattern is compiled to an NFA (Thompson's construction), which
+// is run as a DFA built lazily one state at a time, so matching
+// takes time linear in the input whatever the pattern.
 
 #include "types.h"
 #include "stat.h"
 #include "user.h"
 
-char buf[1024];
-int match(char*, char*);
+#define MAXLIT 64
+#define MAXNSTATE 1024
+#define MAXDSTATE 128   // DFA states cached before starting over
+
+char buf[16384];
+char out[4096];
+int nout;
+int match(char*);
+
+// The longest run of plain characters that every match must
+// contain, found by compile().  Lines without it are skipped
+// without running the matcher.
+char lit[MAXLIT];
+int litlen;
+int skip[256];   // Horspool shift for each byte
+int plain;       // pattern is just lit: finding it is a match
+
+//PAGEBREAK!
+// NFA.  A class state matches one byte from its set and moves to
+// out; a split state moves to out and (if set) out1 without
+// consuming input.
+enum { NS_CLASS, NS_SPLIT, NS_MATCH };
+
+struct nstate {
+  int type;
+  uint set[8];
+  struct nstate *out;
+  struct nstate *out1;
+  int mark;             // last list generation it was added to
+};
+
+struct nstate nstates[MAXNSTATE];
+int nnstate;
+struct nstate *nstart;
+int anchorstart, anchorend;
+
+// A fragment under construction: its start state and a list of
+// the out pointers still to be filled in, threaded through the
+// pointers themselves.
+union ptrlist {
+  union ptrlist *next;
+  struct nstate *s;
+};
+
+struct frag {
+  struct nstate *start;
+  union ptrlist *out;
+};
+
+char *rp;  // parse position
+
+void
+badpattern(char *why)
+{
+  printf(2, "grep: %s\n", why);
+  exit();
+}
+
+struct nstate*
+newstate(int type)
+{
+  struct nstate *s;
+
+  if(nnstate == MAXNSTATE)
+    badpattern("pattern too long");
+  s = &nstates[nnstate++];
+  memset(s, 0, sizeof(*s));
+  s->type = type;
+  return s;
+}
+
+union ptrlist*
+list1(struct nstate **outp)
+{
+  union ptrlist *l;
+
+  l = (union ptrlist*)outp;
+  l->next = 0;
+  return l;
+}
+
+union ptrlist*
+append(union ptrlist *l1, union ptrlist *l2)
+{
+  union ptrlist *old;
+
+  old = l1;
+  while(l1->next)
+    l1 = l1->next;
+  l1->next = l2;
+  return old;
+}
+
+void
+patch(union ptrlist *l, struct nstate *s)
+{
+  union ptrlist *next;
+
+  for(; l; l = next){
+    next = l->next;
+    l->s = s;
+  }
+}
+
+struct frag
+frag(struct nstate *start, union ptrlist *out)
+{
+  struct frag f;
+
+  f.start = start;
+  f.out = out;
+  return f;
+}
+
+void
+setbit(struct nstate *s, int c)
+{
+  s->set[(c & 0xFF) >> 5] |= 1 << (c & 31);
+}
+
+struct frag parsealt(void);
+
+struct frag
+parseclass(void)
+{
+  struct nstate *s;
+  int i, c, neg;
+
+  s = newstate(NS_CLASS);
+  neg = 0;
+  if(*rp == '^'){
+    neg = 1;
+    rp++;
+  }
+  if(*rp == ']')
+    setbit(s, *rp++);
+  while(*rp && *rp != ']'){
+    c = *rp++ & 0xFF;
+    if(rp[0] == '-' && rp[1] && rp[1] != ']'){
+      for(i = c; i <= (rp[1] & 0xFF); i++)
+        setbit(s, i);
+      rp += 2;
+    } else
+      setbit(s, c);
+  }
+  if(*rp++ != ']')
+    badpattern("missing ]");
+  if(neg)
+    for(i = 0; i < 8; i++)
+      s->set[i] = ~s->set[i];
+  return frag(s, list1(&s->out));
+}
+
+struct frag
+parseatom(void)
+{
+  struct nstate *s;
+  struct frag f;
+  int i;
+
+  switch(*rp){
+  case '(':
+    rp++;
+    f = parsealt();
+    if(*rp++ != ')')
+      badpattern("missing )");
+    return f;
+  case '[':
+    rp++;
+    return parseclass();
+  case '.':
+    rp++;
+    s = newstate(NS_CLASS);
+    for(i = 0; i < 8; i++)
+      s->set[i] = ~0;
+    return frag(s, list1(&s->out));
+  case '\\':
+    if(rp[1])
+      rp++;
+    // fall through
+  default:
+    s = newstate(NS_CLASS);
+    setbit(s, *rp++);
+    return frag(s, list1(&s->out));
+  }
+}
+
+struct frag
+parserep(void)
+{
+  struct nstate *s;
+  struct frag f;
+
+  f = parseatom();
+  for(; *rp == '*' || *rp == '+' || *rp == '?'; rp++){
+    s = newstate(NS_SPLIT);
+    s->out = f.start;
+    if(*rp == '*'){
+      patch(f.out, s);
+      f = frag(s, list1(&s->out1));
+    } else if(*rp == '+'){
+      patch(f.out, s);
+      f = frag(f.start, list1(&s->out1));
+    } else
+      f = frag(s, append(f.out, list1(&s->out1)));
+  }
+  return f;
+}
+
+struct frag
+parsecat(void)
+{
+  struct nstate *s;
+  struct frag f, g;
+  int any;
+
+  any = 0;
+  while(*rp && *rp != '|' && *rp != ')'){
+    g = parserep();
+    if(any){
+      patch(f.out, g.start);
+      f.out = g.out;
+    } else
+      f = g;
+    any = 1;
+  }
+  if(!any){  // empty: a split with one way out
+    s = newstate(NS_SPLIT);
+    f = frag(s, list1(&s->out));
+  }
+  return f;
+}
+
+struct frag
+parsealt(void)
+{
+  struct nstate *s;
+  struct frag f, g;
+
+  f = parsecat();
+  while(*rp == '|'){
+    rp++;
+    g = parsecat();
+    s = newstate(NS_SPLIT);
+    s->out = f.start;
+    s->out1 = g.start;
+    f = frag(s, append(f.out, g.out));
+  }
+  return f;
+}
+
+//PAGEBREAK!
+// Literal prefilter.
+
+// Return the end of the atom starting at p.
+char*
+atomend(char *p)
+{
+  int depth;
+
+  if(*p == '\\')
+    return p[1] ? p+2 : p+1;
+  if(*p == '['){
+    p++;
+    if(*p == '^')
+      p++;
+    if(*p == ']')
+      p++;
+    while(*p && *p != ']')
+      p++;
+    return *p ? p+1 : p;
+  }
+  if(*p == '('){
+    for(p++, depth = 1; *p && depth > 0; ){
+      if(*p == '\\' || *p == '[')
+        p = atomend(p);
+      else if(*p == '(')
+        depth++, p++;
+      else if(*p == ')')
+        depth--, p++;
+      else
+        p++;
+    }
+    return p;
+  }
+  return p+1;
+}
 
 void
-grep(char *pattern, int fd)
+findliteral(char *re)
+{
+  char cur[MAXLIT], *p, *q;
+  int i, n, c, opt, more;
+
+  plain = !anchorstart && !anchorend;
+  for(p = re; *p; p++)
+    if(strchr(".[]()*+?|\\", *p))
+      plain = 0;
+  litlen = 0;
+  if(strchr(re, '|'))
+    return;  // no one literal is required
+  n = 0;
+  for(p = re; ; p = q){
+    c = -1;
+    if(*p == '\\' && p[1])
+      c = p[1] & 0xFF;
+    else if(*p && !strchr(".[(", *p))
+      c = *p & 0xFF;
+    q = *p ? atomend(p) : p;
+    opt = 0;
+    more = 1;
+    for(; *q == '*' || *q == '+' || *q == '?'; q++){
+      if(*q != '+')
+        opt = 1;
+      more = 0;
+    }
+    if(c >= 0 && !opt && n < MAXLIT)
+      cur[n++] = c;
+    else
+      more = 0;
+    if(!more || n == MAXLIT || *q == 0){
+      if(n > litlen){
+        memmove(lit, cur, n);
+        litlen = n;
+      }
+      n = 0;
+    }
+    if(*q == 0)
+      break;
+  }
+  // A pattern longer than MAXLIT is only partly in lit.
+  if(litlen != strlen(re))
+    plain = 0;
+  for(i = 0; i < 256; i++)
+    skip[i] = litlen;
+  for(i = 0; i < litlen-1; i++)
+    skip[(uchar)lit[i]] = litlen-1 - i;
+}
+
+void
+compile(char *re)
+{
+  struct frag f;
+  int n;
+
+  if(re[0] == '^'){
+    anchorstart = 1;
+    re++;
+  }
+  n = strlen(re);
+  if(n > 0 && re[n-1] == '$' && (n < 2 || re[n-2] != '\\')){
+    anchorend = 1;
+    re[n-1] = 0;
+  }
+  rp = re;
+  f = parsealt();
+  if(*rp)
+    badpattern("unmatched )");
+  patch(f.out, newstate(NS_MATCH));
+  nstart = f.start;
+  findliteral(re);
+}
+
+//PAGEBREAK!
+// Lazily built DFA.  Each state stands for a sorted list of NFA
+// class and match states, and caches its successor for each byte.
+struct nlist {
+  int n;
+  struct nstate *s[MAXNSTATE];
+};
+
+struct dstate {
+  struct dstate *next[256];
+  int match;
+  int n;
+  struct nstate *l[1];  // really n entries
+};
+
+struct dstate *dstates[MAXDSTATE];
+int ndstate;
+struct dstate *dstart;
+struct nlist nl;
+struct nstate *nstack[2*MAXNSTATE+1];  // each state pushes at most 2
+int gen;
+
+// Add s and the states reachable from it without input to l.
+void
+addstate(struct nlist *l, struct nstate *s)
+{
+  int sp;
+
+  sp = 0;
+  nstack[sp++] = s;
+  while(sp > 0){
+    s = nstack[--sp];
+    if(s == 0 || s->mark == gen)
+      continue;
+    s->mark = gen;
+    if(s->type == NS_SPLIT){
+      nstack[sp++] = s->out1;
+      nstack[sp++] = s->out;
+    } else
+      l->s[l->n++] = s;
+  }
+}
+
+void
+dflush(void)
+{
+  while(ndstate > 0)
+    free(dstates[--ndstate]);
+  dstart = 0;
+}
+
+// Return the DFA state for nl, making it if need be.  May flush the
+// cache, which frees every older state.
+struct dstate*
+dstatefor(void)
+{
+  struct dstate *d;
+  struct nstate *t;
+  int i, j;
+
+  for(i = 1; i < nl.n; i++)
+    for(j = i; j > 0 && nl.s[j-1] > nl.s[j]; j--){
+      t = nl.s[j];
+      nl.s[j] = nl.s[j-1];
+      nl.s[j-1] = t;
+    }
+  for(i = 0; i < ndstate; i++){
+    d = dstates[i];
+    if(d->n != nl.n)
+      continue;
+    for(j = 0; j < nl.n && d->l[j] == nl.s[j]; j++)
+      ;
+    if(j == nl.n)
+      return d;
+  }
+  if(ndstate == MAXDSTATE)
+    dflush();
+  d = malloc(sizeof(*d) + nl.n*sizeof(d->l[0]));
+  if(d == 0)
+    badpattern("out of memory");
+  memset(d, 0, sizeof(*d));
+  d->n = nl.n;
+  for(i = 0; i < nl.n; i++){
+    d->l[i] = nl.s[i];
+    if(nl.s[i]->type == NS_MATCH)
+      d->match = 1;
+  }
+  dstates[ndstate++] = d;
+  return d;
+}
+
+struct dstate*
+startstate(void)
+{
+  gen++;
+  nl.n = 0;
+  addstate(&nl, nstart);
+  return dstart = dstatefor();
+}
+
+// The state d moves to on byte c.
+struct dstate*
+dstep(struct dstate *d, int c)
+{
+  struct dstate *nd;
+  struct nstate *s;
+  int i, cached;
+
+  gen++;
+  nl.n = 0;
+  for(i = 0; i < d->n; i++){
+    s = d->l[i];
+    if(s->type == NS_CLASS && (s->set[c >> 5] & (1 << (c & 31))))
+      addstate(&nl, s->out);
+  }
+  if(!anchorstart)
+    addstate(&nl, nstart);
+  cached = ndstate;
+  nd = dstatefor();
+  if(ndstate >= cached)  // d survived
+    d->next[c] = nd;
+  return nd;
+}
+
+int
+match(char *text)
+{
+  struct dstate *d, *nd;
+  int c;
+
+  d = dstart ? dstart : startstate();
+  for(;;){
+    if(d->match && !anchorend)
+      return 1;
+    if((c = *text++ & 0xFF) == 0)
+      return d->match;
+    if((nd = d->next[c]) == 0)
+      nd = dstep(d, c);
+    d = nd;
+  }
+}
+
+// Find lit in [s, e) with Boyer-Moore-Horspool.
+char*
+findlit(char *s, char *e)
+{
+  int i, k;
+
+  if(litlen == 1)
+    return memchr(s, lit[0], e - s);
+  k = litlen - 1;
+  while(e - s >= litlen){
+    if(s[k] == lit[k]){
+      for(i = k-1; i >= 0 && s[i] == lit[i]; i--)
+        ;
+      if(i < 0)
+        return s;
+    }
+    s += skip[(uchar)s[k]];
+  }
+  return 0;
+}
+
+void
+flush(void)
+{
+  if(nout > 0)
+    write(1, out, nout);
+  nout = 0;
+}
+
+void
+output(char *p, int n)
+{
+  if(nout + n > sizeof(out))
+    flush();
+  if(n > sizeof(out)){
+    write(1, p, n);
+    return;
+  }
+  memmove(out+nout, p, n);
+  nout += n;
+}
+
+// Print the matching lines in [p, e); e follows a newline.
+void
+scan(char *p, char *e)
+{
+  char *s, *q;
+
+  while(p < e){
+    if(litlen > 0){
+      if((s = findlit(p, e)) == 0)
+        return;
+      while(s > p && s[-1] != '\n')
+        s--;
+      p = s;
+    }
+    q = memchr(p, '\n', e - p);
+    *q = 0;
+    if(plain || match(p)){
+      *q = '\n';
+      output(p, q+1 - p);
+    }
+    *q = '\n';
+    p = q+1;
+  }
+}
+
+void
+grep(int fd)
 {
   int n, m;
-  char *p, *q;
+  char *p;
 
   m = 0;
   while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
     m += n;
     buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
-    }
-    if(p == buf)
-      m = 0;
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
-    }
+    for(p = buf+m; p > buf && p[-1] != '\n'; p--)
+      ;
+    scan(buf, p);
+    if(p == buf && m == sizeof(buf)-1)
+      m = 0;  // line too long; drop it
+    m -= p - buf;
+    memmove(buf, p, m);
   }
+  flush();
 }
 
 int
 main(int argc, char *argv[])
 {
   int fd, i;
-  char *pattern;
 
   if(argc <= 1){
     printf(2, "usage: grep pattern [file ...]\n");
     exit();
   }
-  pattern = argv[1];
+  compile(argv[1]);
 
   if(argc <= 2){
-    grep(pattern, 0);
+    grep(0);
     exit();
   }
 
   for(i = 2; i < argc; i++){
     if((fd = open(argv[i], 0)) < 0){
       printf(1, "grep: cannot open %s\n", argv[i]);
-      exit();
+      continue;
     }
-    grep(pattern, fd);
+    grep(fd);
     close(fd);
   }
   exit();
 }
-
-// Regexp matcher from Kernighan & Pike,
-// The Practice of Programming, Chapter 9.
-
-int matchhere(char*, char*);
-int matchstar(int, char*, char*);
-
-int
-match(char *re, char *text)
-{
-  if(re[0] == '^')
-    return matchhere(re+1, text);
-  do{  // must look at empty string
-    if(matchhere(re, text))
-      return 1;
-  }while(*text++ != '\0');
-  return 0;
-}
-
-// matchhere: search for re at beginning of text
-int matchhere(char *re, char *text)
-{
-  if(re[0] == '\0')
-    return 1;
-  if(re[1] == '*')
-    return matchstar(re[0], re+2, text);
-  if(re[0] == '$' && re[1] == '\0')
-    return *text == '\0';
-  if(*text!='\0' && (re[0]=='.' || re[0]==*text))
-    return matchhere(re+1, text+1);
-  return 0;
-}
-
-// matchstar: search for c*re at beginning of text
-int matchstar(int c, char *re, char *text)
-{
-  do{  // a * matches zero or more instances
-    if(matchhere(re, text))
-      return 1;
-  }while(*text!='\0' && (*text++==c || c=='.'));
-  return 0;
-}
-
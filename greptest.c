@@ -0,0 +1,183 @@
+// Tests for grep: anchors, classes, alternation, the literal
+// prefilter, and linear time on patterns that make a backtracking
+// matcher take exponential time.
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define TICKLIMIT 1000  // bound for the slow patterns: 1 second
+
+static char text[] =
+  "apple\n"
+  "banana\n"
+  "a-b\n"
+  "cherry pie\n"
+  "xxx\n"
+  "abcabc\n"
+  "the end\n";
+
+static struct {
+  char *pat;
+  char *want;
+} cases[] = {
+  { "^a",       "apple\na-b\nabcabc\n" },
+  { "e$",       "apple\ncherry pie\n" },
+  { "^xxx$",    "xxx\n" },
+  { "^$",       "" },
+  { "[a-]b",    "a-b\nabcabc\n" },
+  { "[^x]x",    "" },
+  { "^[^a]",    "banana\ncherry pie\nxxx\nthe end\n" },
+  { "pie|end",  "cherry pie\nthe end\n" },
+  { "^(abc)+$", "abcabc\n" },
+  { "an+a",     "banana\n" },
+  { "b.n",      "banana\n" },
+  { "cherry",   "cherry pie\n" },
+  { "zzz",      "" },
+};
+
+static char out[4096];
+
+// Write n bytes of p to file.
+static int
+mkfile(char *file, char *p, int n)
+{
+  int fd;
+
+  if((fd = open(file, O_CREATE|O_RDWR)) < 0)
+    return -1;
+  if(write(fd, p, n) != n){
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  return 0;
+}
+
+// Run grep pat file and return its output in out.
+static char*
+rungrep(char *pat, char *file)
+{
+  char *argv[4];
+  int p[2], n, m;
+
+  argv[0] = "grep";
+  argv[1] = pat;
+  argv[2] = file;
+  argv[3] = 0;
+  if(pipe(p) < 0){
+    printf(2, "greptest: pipe failed\n");
+    exit();
+  }
+  if(fork() == 0){
+    close(1);
+    dup(p[1]);
+    close(p[0]);
+    close(p[1]);
+    exec("grep", argv);
+    printf(2, "greptest: exec grep failed\n");
+    exit();
+  }
+  close(p[1]);
+  for(n = 0; n < sizeof(out)-1 && (m = read(p[0], out+n, sizeof(out)-1-n)) > 0; )
+    n += m;
+  out[n] = 0;
+  close(p[0]);
+  wait();
+  return out;
+}
+
+static int
+testcases(void)
+{
+  int i, fail;
+
+  if(mkfile("greptest.tmp", text, strlen(text)) < 0){
+    printf(2, "greptest: cannot create greptest.tmp\n");
+    return -1;
+  }
+  fail = 0;
+  for(i = 0; i < sizeof(cases)/sizeof(cases[0]); i++){
+    if(strcmp(rungrep(cases[i].pat, "greptest.tmp"), cases[i].want) != 0){
+      printf(2, "FAILED: grep '%s' printed:\n%s", cases[i].pat, out);
+      fail = 1;
+    }
+  }
+  unlink("greptest.tmp");
+  return fail ? -1 : 0;
+}
+
+// A matching line that straddles grep's read buffer must not be
+// lost by the prefilter.
+static int
+testprefilter(void)
+{
+  static char buf[20000];
+  char *line = "needle in haystack\n";
+  int n, fail;
+
+  for(n = 0; n + 12 < 16384 - 5; n += 12)
+    memmove(buf+n, "filler line\n", 12);
+  memmove(buf+n, line, strlen(line));
+  n += strlen(line);
+  memmove(buf+n, "filler line\n", 12);
+  n += 12;
+  if(mkfile("greptest.tmp", buf, n) < 0){
+    printf(2, "greptest: cannot create greptest.tmp\n");
+    return -1;
+  }
+  fail = 0;
+  if(strcmp(rungrep("needle", "greptest.tmp"), line) != 0 ||
+     strcmp(rungrep("hay.*k$", "greptest.tmp"), line) != 0){
+    printf(2, "FAILED: prefilter lost a line across the buffer\n");
+    fail = 1;
+  }
+  unlink("greptest.tmp");
+  return fail ? -1 : 0;
+}
+
+// Each of these is exponential for a backtracking matcher on a
+// long run of a's with no b; the DFA takes linear time.
+static int
+testslow(void)
+{
+  static char buf[3001];
+  char *pats[] = { "a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*b", "(a|aa)*b", "(a*)*b" };
+  int i, start, t, fail;
+
+  memset(buf, 'a', sizeof(buf)-1);
+  buf[sizeof(buf)-1] = '\n';
+  if(mkfile("greptest.tmp", buf, sizeof(buf)) < 0){
+    printf(2, "greptest: cannot create greptest.tmp\n");
+    return -1;
+  }
+  fail = 0;
+  for(i = 0; i < sizeof(pats)/sizeof(pats[0]); i++){
+    start = uptime();
+    if(*rungrep(pats[i], "greptest.tmp") != 0){
+      printf(2, "FAILED: grep '%s' matched a line with no b\n", pats[i]);
+      fail = 1;
+    }
+    if((t = uptime() - start) > TICKLIMIT){
+      printf(2, "FAILED: grep '%s' took %d ticks\n", pats[i], t);
+      fail = 1;
+    }
+  }
+  unlink("greptest.tmp");
+  return fail ? -1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fail = 0;
+
+  if(testcases() < 0)
+    fail = 1;
+  if(testprefilter() < 0)
+    fail = 1;
+  if(testslow() < 0)
+    fail = 1;
+  if(!fail)
+    printf(1, "** grep tests passed! **\n");
+  exit();
+}
@@ -0,0 +1,25 @@
+// Pages the kernel maps read-only at the top of every user address
+// space (UKDATA and UUDATA in memlayout.h), so that uptime(), getpid()
+// and friends can be answered in user space without a trap.
+// Include date.h first.
+
+#define KDATA_SYSENTER 4   // offset of sysenter, for usys.S
+
+#ifndef __ASSEMBLER__
+// Shared by all processes. The kernel bumps dateseq before and
+// after rewriting date; a reader that sees it odd or changed
+// across its copy must read again.
+struct kdata {
+  uint ticks;            // same as uptime()
+  uint sysenter;         // non-zero if system calls may use sysenter
+  uint dateseq;          // date update sequence number
+  struct rtcdate date;   // wall clock, refreshed once a second
+};
+
+// One per process, refreshed whenever the process is switched in.
+struct udata {
+  uint pid;
+  uint uid;
+  uint gid;
+};
+#endif // __ASSEMBLER__
@@ -28,6 +28,15 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// Installation is deferred. A commit appends the transaction's
+// blocks after those of earlier, still uninstalled, commits and
+// rewrites the header; the committed blocks stay dirty (pinned)
+// in the buffer cache. When the log runs short of space,
+// checkpoint() writes each of those blocks to its home location
+// once, in block order, from the cache, and empties the log.
+// A block may appear in the log more than once; recovery
+// installs them in order, so the last copy wins.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -41,14 +50,22 @@ struct log {
   int start;
   int size;
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int committing;  // in commit() or checkpoint(), please wait.
+  int committed;   // lh.block[0..committed-1] are committed
   int dev;
   struct logheader lh;
 };
 struct log log;
 
+#ifdef PDX_XV6
+#define FLUSHDELAY TPS  // ticks before logflusher installs commits
+#else
+#define FLUSHDELAY 100
+#endif // PDX_XV6
+
 static void recover_from_log(void);
 static void commit();
+static void checkpoint(void);
 
 void
 initlog(int dev)
@@ -65,7 +82,8 @@ initlog(int dev)
   recover_from_log();
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location.
+// Only used during recovery; see checkpoint().
 static void
 install_trans(void)
 {
@@ -129,9 +147,20 @@ begin_op(void)
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
-      sleep(&log, &log.lock);
+    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE-1){
+      // this op might exhaust log space.
+      if(log.outstanding > 0){
+        // wait for commit.
+        sleep(&log, &log.lock);
+        continue;
+      }
+      // everything is committed; install it to make room.
+      log.committing = 1;
+      release(&log.lock);
+      checkpoint();
+      acquire(&log.lock);
+      log.committing = 0;
+      wakeup(&log);
     } else {
       log.outstanding += 1;
       release(&log.lock);
@@ -173,13 +202,13 @@ end_op(void)
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy the current transaction's blocks from cache to log.
 static void
 write_log(void)
 {
   int tail;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
+  for (tail = log.committed; tail < log.lh.n; tail++) {
     struct buf *to = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
     memmove(to->data, from->data, BSIZE);
@@ -192,12 +221,76 @@ write_log(void)
 static void
 commit()
 {
-  if (log.lh.n > 0) {
+  if (log.lh.n > log.committed) {
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.committed = log.lh.n;
+  }
+}
+
+// Write every committed block from the cache to its home
+// location, each once and in block order, then empty the log.
+// Called with no FS system calls outstanding.
+static void
+checkpoint(void)
+{
+  int blocks[LOGSIZE];
+  int i, j, n, b;
+  struct buf *buf;
+
+  // insertion sort, dropping duplicates
+  n = 0;
+  for (i = 0; i < log.committed; i++) {
+    b = log.lh.block[i];
+    for (j = n; j > 0 && blocks[j-1] > b; j--)
+      ;
+    if (j > 0 && blocks[j-1] == b)
+      continue;
+    memmove(&blocks[j+1], &blocks[j], (n-j)*sizeof(blocks[0]));
+    blocks[j] = b;
+    n++;
+  }
+  for (i = 0; i < n; i++) {
+    buf = bread(log.dev, blocks[i]);  // still pinned in the cache
+    bwrite(buf);  // write home; clears B_DIRTY
+    brelse(buf);
+  }
+  log.lh.n = log.committed = 0;
+  write_head();    // Erase the transactions from the log
+}
+
+// Kernel thread (see forkret()) that checkpoints the log in
+// the background: FLUSHDELAY ticks after a commit leaves
+// blocks uninstalled, or sooner once half the log is used, so
+// that commits rarely have to wait in begin_op() for one.
+void
+logflusher(void *arg)
+{
+  uint t0;
+
+  for(;;){
+    acquire(&log.lock);
+    while(log.committed == 0)
+      sleep(&log, &log.lock);
+    release(&log.lock);
+
+    // Let more commits coalesce.
+    t0 = ticks;
+    while(ticks - t0 < FLUSHDELAY && log.committed < LOGSIZE/2)
+      sleep(&ticks, (struct spinlock *)0);
+
+    acquire(&log.lock);
+    while(log.committing || log.outstanding > 0)
+      sleep(&log, &log.lock);
+    if(log.committed > 0){
+      log.committing = 1;
+      release(&log.lock);
+      checkpoint();
+      acquire(&log.lock);
+      log.committing = 0;
+      wakeup(&log);
+    }
+    release(&log.lock);
   }
 }
 
@@ -221,7 +314,9 @@ log_write(struct buf *b)
     panic("log_write outside of trans");
 
   acquire(&log.lock);
-  for (i = 0; i < log.lh.n; i++) {
+  // absorb within this transaction; committed slots must
+  // not change, so a block logged earlier gets a new slot.
+  for (i = log.committed; i < log.lh.n; i++) {
     if (log.lh.block[i] == b->blockno)   // log absorbtion
       break;
   }
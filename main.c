@@ -22,6 +22,8 @@ main(void)
   mpinit();        // detect other processors
   lapicinit();     // interrupt controller
   seginit();       // segment descriptors
+  fpuinit();       // FPU and SSE
+  stringinit();    // pick memmove() for this CPU
   picinit();       // disable pic
   ioapicinit();    // another interrupt controller
   consoleinit();   // console hardware
@@ -30,6 +32,7 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  futexinit();     // futex wait queues
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -43,6 +46,7 @@ mpenter(void)
 {
   switchkvm();
   seginit();
+  fpuinit();
   lapicinit();
   mpmain();
 }
@@ -0,0 +1,83 @@
+// Microbenchmark for the kernel's memmove(): throughput of read()
+// from a cached file and of pipe transfers at several chunk sizes.
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define FILESIZE (64*1024)
+#define TOTAL    (4*1024*1024)
+
+static char buf[8192];
+static int sizes[] = { 16, 64, 256, 1024, 4096, 8192 };
+
+static void
+report(char *what, int size, int t)
+{
+  printf(1, "%s %5d bytes: %4d ticks", what, size, t);
+  if(t > 0)
+    printf(1, " (%d KB/tick)", TOTAL/1024/t);
+  printf(1, "\n");
+}
+
+static void
+filebench(int size)
+{
+  int fd, n, done, start;
+
+  start = uptime();
+  for(done = 0; done < TOTAL; ){
+    if((fd = open("membench.tmp", O_RDONLY)) < 0){
+      printf(2, "membench: cannot open membench.tmp\n");
+      exit();
+    }
+    while(done < TOTAL && (n = read(fd, buf, size)) > 0)
+      done += n;
+    close(fd);
+  }
+  report("file read", size, uptime() - start);
+}
+
+static void
+pipebench(int size)
+{
+  int p[2], n, done, start;
+
+  if(pipe(p) < 0){
+    printf(2, "membench: pipe failed\n");
+    exit();
+  }
+  start = uptime();
+  if(fork() == 0){
+    close(p[0]);
+    for(done = 0; done < TOTAL; done += size)
+      write(p[1], buf, size);
+    exit();
+  }
+  close(p[1]);
+  for(done = 0; (n = read(p[0], buf, size)) > 0; )
+    done += n;
+  close(p[0]);
+  wait();
+  report("pipe     ", size, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i;
+
+  if((fd = open("membench.tmp", O_CREATE|O_RDWR)) < 0){
+    printf(2, "membench: cannot create membench.tmp\n");
+    exit();
+  }
+  for(i = 0; i < FILESIZE; i += sizeof(buf))
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    filebench(sizes[i]);
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    pipebench(sizes[i]);
+  unlink("membench.tmp");
+  exit();
+}
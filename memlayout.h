@@ -8,6 +8,11 @@
 #define KERNBASE 0x80000000         // First kernel virtual address
 #define KERNLINK (KERNBASE+EXTMEM)  // Address where kernel is linked
 
+// Read-only data pages at the top of user space (see kdata.h)
+#define UKDATA  (KERNBASE-0x1000)   // shared struct kdata
+#define UUDATA  (KERNBASE-0x2000)   // per-process struct udata
+#define USERTOP UUDATA              // user memory must end below here
+
 #define V2P(a) (((uint) (a)) - KERNBASE)
 #define P2V(a) (((void *) (a)) + KERNBASE)
 
@@ -16,6 +16,7 @@
 #endif
 
 #define NINODES 200
+#define DPB (BSIZE/sizeof(struct dirent))
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
@@ -31,7 +32,10 @@ struct superblock sb;
 char zeroes[BSIZE];
 uint freeinode = 1;
 uint freeblock;
-
+struct dirent *rootdir;
+uint nrootbucket;  // hash buckets in the root directory (see fs.h)
+uint nrootdir;     // entries, including empty ones
+uint maxrootdir;
 
 void balloc(int);
 void wsect(uint, void*);
@@ -39,7 +43,9 @@ void winode(uint, struct dinode*);
 void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
+uint mapblock(struct dinode *din, uint fbn);
 void iappend(uint inum, void *p, int n);
+void rootlink(char *name, uint inum);
 
 // convert to intel byte order
 ushort
@@ -68,8 +74,7 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  uint rootino, inum;
   char buf[BSIZE];
   struct dinode din;
 
@@ -117,15 +122,18 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
+  // Enough buckets to leave them about half full; the kernel
+  // adds more as the directory grows.
+  nrootbucket = argc / (DPB/2) + 1;
+  nrootdir = nrootbucket*DPB;
+  maxrootdir = nrootdir + argc;
+  if((rootdir = calloc(maxrootdir + DPB, sizeof(struct dirent))) == 0){  // + rounding
+    perror("calloc");
+    exit(1);
+  }
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  rootlink(".", rootino);
+  rootlink("..", rootino);
 
   for(i = 2; i < argc; i++){
     assert(index(argv[i], '/') == 0);
@@ -144,10 +152,7 @@ main(int argc, char *argv[])
 
     inum = ialloc(T_FILE);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, argv[i], DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    rootlink(argv[i], inum);
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -155,11 +160,11 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
+  // write the hashed root dir, rounded up to a whole block
+  nrootdir = (nrootdir + DPB-1) / DPB * DPB;
+  iappend(rootino, rootdir, nrootdir * sizeof(struct dirent));
   rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
+  din.minor = xshort(nrootbucket);
   winode(rootino, &din);
 
   balloc(freeblock);
@@ -238,16 +243,74 @@ void
 balloc(int used)
 {
   uchar buf[BSIZE];
-  int i;
+  int i, b;
 
   printf("balloc: first %d blocks have been allocated\n", used);
-  assert(used < BSIZE*8);
-  bzero(buf, BSIZE);
-  for(i = 0; i < used; i++){
-    buf[i/8] = buf[i/8] | (0x1 << (i%8));
+  assert(used < FSSIZE);
+  for(b = 0; b*BSIZE*8 < used; b++){
+    bzero(buf, BSIZE);
+    for(i = 0; i < BSIZE*8 && b*BSIZE*8 + i < used; i++){
+      buf[i/8] = buf[i/8] | (0x1 << (i%8));
+    }
+    printf("balloc: write bitmap block at sector %d\n", xint(sb.bmapstart)+b);
+    wsect(xint(sb.bmapstart)+b, buf);
   }
-  printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-  wsect(sb.bmapstart, buf);
+}
+
+// Add name to the root directory: in its hash bucket if that
+// block has a free slot, else at the end of the overflow area.
+void
+rootlink(char *name, uint inum)
+{
+  struct dirent *de, *end;
+
+  de = &rootdir[dirbucket(dirhash(name), nrootbucket) * DPB];
+  for(end = de + DPB; de < end; de++)
+    if(de->inum == 0)
+      break;
+  if(de == end){
+    assert(nrootdir < maxrootdir);
+    de = &rootdir[nrootdir++];
+  }
+  de->inum = xshort(inum);
+  strncpy(de->name, name, DIRSIZ);
+}
+
+// Return the block holding block fbn of din, allocating
+// it and any indirect blocks on the way. Mirrors bmap().
+uint
+mapblock(struct dinode *din, uint fbn)
+{
+  uint indirect[NINDIRECT];
+  uint addr, n;
+  int level;
+
+  if(fbn < NDIRECT){
+    if(xint(din->addrs[fbn]) == 0)
+      din->addrs[fbn] = xint(freeblock++);
+    return xint(din->addrs[fbn]);
+  }
+  fbn -= NDIRECT;
+  n = NINDIRECT;
+  for(level = 0; fbn >= n; level++){
+    assert(level < NLEVEL-1);
+    fbn -= n;
+    n *= NINDIRECT;
+  }
+  if(xint(din->addrs[NDIRECT+level]) == 0)
+    din->addrs[NDIRECT+level] = xint(freeblock++);
+  addr = xint(din->addrs[NDIRECT+level]);
+  while(n > 1){
+    n /= NINDIRECT;
+    rsect(addr, (char*)indirect);
+    if(indirect[fbn/n] == 0){
+      indirect[fbn/n] = xint(freeblock++);
+      wsect(addr, (char*)indirect);
+    }
+    addr = xint(indirect[fbn/n]);
+    fbn %= n;
+  }
+  return addr;
 }
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
@@ -259,7 +322,6 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
@@ -268,22 +330,7 @@ iappend(uint inum, void *xp, int n)
   while(n > 0){
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
-      if(xint(din.addrs[fbn]) == 0){
-        din.addrs[fbn] = xint(freeblock++);
-      }
-      x = xint(din.addrs[fbn]);
-    } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
-    }
+    x = mapblock(&din, fbn);
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
     bcopy(p, buf + off - (fbn * BSIZE), n1);
@@ -38,6 +38,22 @@
 #define CR0_PG          0x80000000      // Paging
 
 #define CR4_PSE         0x00000010      // Page size extension
+#define CR4_PGE         0x00000080      // Global pages
+#define CR4_OSFXSR      0x00000200      // fxsave/fxrstor and SSE
+#define CR4_OSXMMEXCPT  0x00000400      // unmasked SSE exceptions
+
+// CPUID leaf 1 feature flags (%edx)
+#define CPUID_PSE       0x00000008      // 4Mbyte pages
+#define CPUID_SEP       0x00000800      // sysenter/sysexit
+#define CPUID_PGE       0x00002000      // global pages
+#define CPUID_FXSR      0x01000000      // fxsave/fxrstor
+#define CPUID_SSE       0x02000000
+#define CPUID_SSE2      0x04000000
+
+// Model specific registers
+#define MSR_SYSENTER_CS  0x174          // sysenter code segment
+#define MSR_SYSENTER_ESP 0x175          // sysenter stack pointer
+#define MSR_SYSENTER_EIP 0x176          // sysenter entry point
 
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
@@ -123,6 +139,7 @@ struct segdesc {
 #define NPDENTRIES      1024    // # directory entries per page directory
 #define NPTENTRIES      1024    // # PTEs per page table
 #define PGSIZE          4096    // bytes mapped by a page
+#define PDSIZE          (PGSIZE*NPTENTRIES)  // bytes mapped by a PDE
 
 #define PGSHIFT         12      // log2(PGSIZE)
 #define PTXSHIFT        12      // offset of PTX in a linear address
@@ -140,6 +157,7 @@ struct segdesc {
 #define PTE_A           0x020   // Accessed
 #define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
+#define PTE_G           0x100   // Global (kept in the TLB across lcr3)
 #define PTE_MBZ         0x180   // Bits must be zero
 
 // Address in page table or page directory entry
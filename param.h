@@ -3,15 +3,16 @@
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // initial number of cached i-nodes
+#define NDCACHE     128  // directory name cache entries
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define MAXOPBLOCKS  16  // max # of blocks any FS op writes
+#define LOGSIZE      (MAXOPBLOCKS*6)  // max data blocks in on-disk log
+#define NBUF         (MAXOPBLOCKS*10) // size of disk block cache
 #ifdef PDX_XV6
-#define FSSIZE       2000  // size of file system in blocks
+#define FSSIZE      20000  // size of file system in blocks
 #else
 #define FSSIZE       1000  // size of file system in blocks
 #endif // PDX_XV6
@@ -2,18 +2,107 @@
 #include "stat.h"
 #include "user.h"
 
+// Output is buffered per descriptor.  A buffer on the console is
+// flushed at the end of every printf() call, so a line (or a prompt)
+// goes out in one write; files and pipes are flushed only when the
+// buffer fills, or on fork, exec, close and exit (see ulib.c).
+#define NOBUF     16    // descriptors with buffers; others write directly
+#define OBUFSIZE  512
+
+#define OB_TTY    1
+#define OB_FULL   2
+
+static struct obuf {
+  int n;
+  int mode;     // 0 until the first write tells us what fd is
+  char buf[OBUFSIZE];
+} obuf[NOBUF];
+
+extern void (*_flush)(int);
+
+static void
+flushbuf(int fd)
+{
+  struct obuf *b = &obuf[fd];
+
+  if(b->n > 0)
+    write(fd, b->buf, b->n);
+  b->n = 0;
+}
+
+// Flush fd, or every descriptor if fd is -1.  After a flush for
+// close() the descriptor may be reused for something else, so its
+// mode is looked up again on the next write.
+void
+fflush(int fd)
+{
+  if(fd < 0){
+    for(fd = 0; fd < NOBUF; fd++)
+      flushbuf(fd);
+    return;
+  }
+  if(fd < NOBUF)
+    flushbuf(fd);
+}
+
+static void
+closebuf(int fd)
+{
+  fflush(fd);
+  if(fd >= 0 && fd < NOBUF)
+    obuf[fd].mode = 0;
+}
+
 static void
 putc(int fd, char c)
 {
-  write(fd, &c, 1);
+  struct obuf *b;
+  struct stat st;
+
+  if(fd < 0 || fd >= NOBUF){
+    write(fd, &c, 1);
+    return;
+  }
+  b = &obuf[fd];
+  if(b->mode == 0){
+    if(fstat(fd, &st) == 0 && st.type == T_DEV)
+      b->mode = OB_TTY;
+    else
+      b->mode = OB_FULL;
+    _flush = closebuf;
+  }
+  b->buf[b->n++] = c;
+  if(b->n == OBUFSIZE)
+    flushbuf(fd);
+}
+
+static void
+pad(int fd, int n, char c)
+{
+  while(n-- > 0)
+    putc(fd, c);
+}
+
+static void
+putstr(int fd, char *s, int width, int left)
+{
+  int n;
+
+  n = strlen(s);
+  if(!left)
+    pad(fd, width - n, ' ');
+  while(*s)
+    putc(fd, *s++);
+  if(left)
+    pad(fd, width - n, ' ');
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+printint(int fd, int xx, int base, int sgn, int width, int flags)
 {
   static char digits[] = "0123456789ABCDEF";
   char buf[16];
-  int i, neg;
+  int i, n, neg;
   uint x;
 
   neg = 0;
@@ -28,58 +117,83 @@ printint(int fd, int xx, int base, int sgn)
   do{
     buf[i++] = digits[x % base];
   }while((x /= base) != 0);
-  if(neg)
-    buf[i++] = '-';
+  n = i + neg;
 
+  if(flags == '0'){
+    if(neg)
+      putc(fd, '-');
+    pad(fd, width - n, '0');
+  } else {
+    if(flags != '-')
+      pad(fd, width - n, ' ');
+    if(neg)
+      putc(fd, '-');
+  }
   while(--i >= 0)
     putc(fd, buf[i]);
+  if(flags == '-')
+    pad(fd, width - n, ' ');
 }
 
-// Print to the given fd. Only understands %d, %x, %p, %s.
+// Print to the given fd. Understands %d, %u, %x, %p, %s and %c, with
+// an optional '-' (left-justify) or '0' (zero-pad) flag and a width.
 void
 printf(int fd, char *fmt, ...)
 {
-  char *s;
-  int c, i, state;
+  char *s, cbuf[2];
+  int c, i, state, width, flags;
   uint *ap;
 
-  state = 0;
+  state = width = flags = 0;
   ap = (uint*)(void*)&fmt + 1;
   for(i = 0; fmt[i]; i++){
     c = fmt[i] & 0xff;
     if(state == 0){
       if(c == '%'){
         state = '%';
+        width = flags = 0;
       } else {
         putc(fd, c);
       }
-    } else if(state == '%'){
-      if(c == 'd'){
-        printint(fd, *ap, 10, 1);
-        ap++;
-      } else if(c == 'x' || c == 'p'){
-        printint(fd, *ap, 16, 0);
-        ap++;
-      } else if(c == 's'){
-        s = (char*)*ap;
-        ap++;
-        if(s == 0)
-          s = "(null)";
-        while(*s != 0){
-          putc(fd, *s);
-          s++;
-        }
-      } else if(c == 'c'){
-        putc(fd, *ap);
-        ap++;
-      } else if(c == '%'){
-        putc(fd, c);
-      } else {
-        // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
-      }
-      state = 0;
+      continue;
+    }
+    if((c == '-' || c == '0') && width == 0 && flags == 0){
+      flags = c;
+      continue;
+    }
+    if(c >= '0' && c <= '9'){
+      width = width*10 + c - '0';
+      continue;
+    }
+    if(c == 'd'){
+      printint(fd, *ap, 10, 1, width, flags);
+      ap++;
+    } else if(c == 'u'){
+      printint(fd, *ap, 10, 0, width, flags);
+      ap++;
+    } else if(c == 'x' || c == 'p'){
+      printint(fd, *ap, 16, 0, width, flags);
+      ap++;
+    } else if(c == 's'){
+      s = (char*)*ap;
+      ap++;
+      if(s == 0)
+        s = "(null)";
+      putstr(fd, s, width, flags == '-');
+    } else if(c == 'c'){
+      cbuf[0] = *ap;
+      cbuf[1] = 0;
+      putstr(fd, cbuf, width, flags == '-');
+      ap++;
+    } else if(c == '%'){
+      putc(fd, c);
+    } else {
+      // Unknown % sequence.  Print it to draw attention.
+      putc(fd, '%');
+      putc(fd, c);
     }
+    state = 0;
   }
+  if(fd >= 0 && fd < NOBUF && obuf[fd].mode == OB_TTY)
+    flushbuf(fd);
 }
@@ -0,0 +1,108 @@
+// Tests for the buffered printf().
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NLINES 2000
+
+static char buf[512];
+
+// Print fmt to a file and compare what comes back with want.
+static int
+check(char *want, char *fmt, int a, int b)
+{
+  int fd, n;
+
+  if((fd = open("printf.tmp", O_CREATE|O_RDWR)) < 0){
+    printf(2, "FAILED: create printf.tmp\n");
+    return -1;
+  }
+  printf(fd, fmt, a, b);
+  close(fd);
+  fd = open("printf.tmp", O_RDONLY);
+  n = read(fd, buf, sizeof(buf)-1);
+  close(fd);
+  unlink("printf.tmp");
+  buf[n < 0 ? 0 : n] = 0;
+  if(strcmp(buf, want) != 0){
+    printf(2, "FAILED: \"%s\" printed \"%s\", want \"%s\"\n", fmt, buf, want);
+    return -1;
+  }
+  return 0;
+}
+
+static int
+testformats(void)
+{
+  int fail = 0;
+
+  fail |= check("42 -7", "%d %d", 42, -7);
+  fail |= check("4294967295", "%u", -1, 0);
+  fail |= check("FF 0", "%x %p", 255, 0);
+  fail |= check("[   42][-7   ]", "[%5d][%-4d]", 42, -7);
+  fail |= check("[-0042][00ff]", "[%05d][%04x]", -42, 0xff);
+  fail |= check("[ab   ][  x]", "[%-5s][%3c]", (int)"ab", 'x');
+  fail |= check("100%", "%d%%", 100, 0);
+  return fail;
+}
+
+// Output left in a buffer must survive fork() and exit() exactly once.
+static int
+testflush(void)
+{
+  int fd, n, pid;
+
+  if((fd = open("printf.tmp", O_CREATE|O_RDWR)) < 0){
+    printf(2, "FAILED: create printf.tmp\n");
+    return -1;
+  }
+  printf(fd, "parent ");
+  if((pid = fork()) == 0){
+    printf(fd, "child ");
+    exit();
+  }
+  wait();
+  printf(fd, "done");
+  close(fd);
+  fd = open("printf.tmp", O_RDONLY);
+  n = read(fd, buf, sizeof(buf)-1);
+  close(fd);
+  unlink("printf.tmp");
+  buf[n < 0 ? 0 : n] = 0;
+  if(pid < 0 || strcmp(buf, "parent child done") != 0){
+    printf(2, "FAILED: fork/exit flush gave \"%s\"\n", buf);
+    return -1;
+  }
+  return 0;
+}
+
+static void
+timing(void)
+{
+  int fd, i, start;
+
+  if((fd = open("printf.tmp", O_CREATE|O_RDWR)) < 0)
+    return;
+  start = uptime();
+  for(i = 0; i < NLINES; i++)
+    printf(fd, "line %d of %d: %s\n", i, NLINES, "some output text");
+  close(fd);
+  unlink("printf.tmp");
+  printf(1, "%d lines printed to a file in %d ticks\n", NLINES,
+      uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fail = 0;
+
+  if(testformats() < 0)
+    fail = 1;
+  if(testflush() < 0)
+    fail = 1;
+  if(!fail)
+    printf(1, "** printf tests passed! **\n");
+  timing();
+  exit();
+}
@@ -6,6 +6,7 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #ifdef CS333_P2
 #include "uproc.h"
 #endif //CS333P2
@@ -46,6 +47,10 @@ static struct {
 #endif //CS333_P4
 } ptable;
 
+// Locks serializing growproc() per address space; see vmlock().
+#define NVMLOCK 16
+static struct sleeplock vmlocks[NVMLOCK];
+
 // list management function prototypes
 #ifdef CS333_P3
 static void initProcessLists(void);
@@ -65,7 +70,11 @@ static void wakeup1(void* chan);
   void
 pinit(void)
 {
+  int i;
+
   initlock(&ptable.lock, "ptable");
+  for(i = 0; i < NVMLOCK; i++)
+    initsleeplock(&vmlocks[i], "vm");
 }
 
 // Must be called with interrupts disabled
@@ -209,6 +218,9 @@ allocproc(void)
   p->cpu_ticks_in = 0;
 #endif //CS333_P2
 
+  p->thread = 0;
+  p->fpuused = 0;
+
   //priority and budget allocation
 #ifdef CS333_P4
 #endif //CS333_P4
@@ -296,23 +308,141 @@ userinit(void)
   release(&ptable.lock);
 }
 
-// Grow current process's memory by n bytes.
+// Kernel threads start here, "returning" from swtch() in
+// scheduler() like forkret() does.
+static void
+kthreadmain(void (*fn)(void*), void *arg)
+{
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+  fn(arg);
+  panic("kthread returned");
+}
+
+// Start a kernel thread running fn(arg). It is a proc with a
+// kernel stack and context but no user memory (pgdir is 0),
+// open files or cwd, and is scheduled like any other proc.
+// fn must never return. Returns the pid, or -1.
+int
+kthread_create(void (*fn)(void*), void *arg, char *name)
+{
+  struct proc *p;
+  uint *sp;
+
+  if((p = allocproc()) == 0)
+    return -1;
+
+  // Replace allocproc's forkret/trapret frame with a call
+  // to kthreadmain(fn, arg); no trap frame is needed.
+  sp = (uint*)(p->kstack + KSTACKSIZE);
+  *--sp = (uint)arg;
+  *--sp = (uint)fn;
+  *--sp = 0;  // fake return PC
+  p->tf = 0;
+  p->context = (struct context*)sp - 1;
+  memset(p->context, 0, sizeof *p->context);
+  p->context->eip = (uint)kthreadmain;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  acquire(&ptable.lock);
+#ifdef CS333_P4
+  if(stateListRemove(&ptable.list[EMBRYO], p) == -1)
+    panic("kthread_create: not on embryo list");
+  assertState(p, EMBRYO, __FUNCTION__, __LINE__);
+  p->state = RUNNABLE;
+  stateListAdd(&ptable.ready[p->priority], p);
+#elif defined(CS333_P3)
+  if(stateListRemove(&ptable.list[EMBRYO], p) == -1)
+    panic("kthread_create: not on embryo list");
+  assertState(p, EMBRYO, __FUNCTION__, __LINE__);
+  p->state = RUNNABLE;
+  stateListAdd(&ptable.list[RUNNABLE], p);
+#else
+  p->state = RUNNABLE;
+#endif // CS333_P4
+  release(&ptable.lock);
+
+  return p->pid;
+}
+
+// Does a proc other than p use address space pgdir? clone()
+// threads share their parent's. Caller must hold ptable.lock.
+static int
+vmshared(pde_t *pgdir, struct proc *p)
+{
+  struct proc *q;
+
+  for(q = ptable.proc; q < &ptable.proc[NPROC]; q++)
+    if(q != p && q->state != UNUSED && q->pgdir == pgdir)
+      return 1;
+  return 0;
+}
+
+// Lock serializing changes to the address space pgdir and to the
+// sz of the procs sharing it.  Unrelated address spaces that hash
+// to the same lock merely wait for each other.
+static struct sleeplock*
+vmlock(pde_t *pgdir)
+{
+  return &vmlocks[((uint)pgdir >> PGSHIFT) % NVMLOCK];
+}
+
+// Free pgdir, which the current process has stopped using,
+// unless a clone() thread still uses it; reaping the last
+// such thread frees it then.
+void
+vmrelease(pde_t *pgdir)
+{
+  int shared;
+
+  acquire(&ptable.lock);
+  shared = vmshared(pgdir, 0);
+  release(&ptable.lock);
+  if(!shared)
+    freevm(pgdir);
+}
+
+// Grow current process's memory by n bytes, setting *oldsz
+// to the size before, read under the same lock so threads
+// growing at once get disjoint memory.
 // Return 0 on success, -1 on failure.
   int
-growproc(int n)
+growproc(int n, uint *oldsz)
 {
   uint sz;
+  int shared;
+  struct proc *p;
   struct proc *curproc = myproc();
+  struct sleeplock *lk = vmlock(curproc->pgdir);
 
+  acquiresleep(lk);
   sz = curproc->sz;
+  *oldsz = sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0){
+      releasesleep(lk);
       return -1;
+    }
   } else if(n < 0){
-    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    // Threads on other CPUs may have the pages in their TLBs.
+    acquire(&ptable.lock);
+    shared = vmshared(curproc->pgdir, curproc);
+    release(&ptable.lock);
+    if(shared)
+      sz = shrinkuvm(curproc->pgdir, sz, sz + n);
+    else
+      sz = deallocuvm(curproc->pgdir, sz, sz + n);
+    if(sz == 0){
+      releasesleep(lk);
       return -1;
+    }
   }
-  curproc->sz = sz;
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state != UNUSED && p->pgdir == curproc->pgdir)
+      p->sz = sz;
+  release(&ptable.lock);
+  releasesleep(lk);
   switchuvm(curproc);
   return 0;
 }
@@ -333,8 +463,12 @@ fork(void)
     return -1;
   }
 
-  // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+  // Copy process state from proc.  The vm lock keeps a thread
+  // from shrinking the address space during the copy.
+  acquiresleep(vmlock(curproc->pgdir));
+  np->pgdir = copyuvm(curproc->pgdir, curproc->sz);
+  releasesleep(vmlock(curproc->pgdir));
+  if(np->pgdir == 0){
     kfree(np->kstack);
     np->kstack = 0;
 
@@ -359,7 +493,7 @@ fork(void)
   np->sz = curproc->sz;
   np->parent = curproc;
   *np->tf = *curproc->tf;
-
+  fpufork(np, curproc);
 
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
@@ -413,6 +547,147 @@ fork(void)
 
 }
 
+// Create a thread: a child that shares the current process's
+// address space and runs fn(arg) on the PGSIZE user stack at
+// stack, which join() hands back. Open files and cwd are
+// duplicated as in fork(): the files themselves (and their
+// offsets) are shared, but each thread has its own descriptor
+// table and cwd, since nothing locks a proc's ofile[] and cwd
+// against other procs. Returns the thread's pid.
+int
+clone(void (*fn)(void*), void *arg, void *stack)
+{
+  int i;
+  uint pid, sp, ustack[2];
+  struct proc *np;
+  struct proc *curproc = myproc();
+
+  if((np = allocproc()) == 0)
+    return -1;
+
+  np->pgdir = curproc->pgdir;
+  np->sz = curproc->sz;
+  np->parent = curproc;
+  np->thread = 1;
+  np->ustack = stack;
+  *np->tf = *curproc->tf;
+
+  // Start at fn, as if called with arg; returning faults.
+  sp = (uint)stack + PGSIZE - sizeof(ustack);
+  ustack[0] = 0xffffffff;  // fake return PC
+  ustack[1] = (uint)arg;
+  if(copyout(np->pgdir, sp, ustack, sizeof(ustack)) < 0){
+    // stack is not user memory (e.g. the guard page).  Undo
+    // allocproc(); the address space is curproc's, so keep it.
+    np->pgdir = 0;
+    np->thread = 0;
+    kfree(np->kstack);
+    np->kstack = 0;
+    acquire(&ptable.lock);
+#ifdef CS333_P3
+    if(stateListRemove(&ptable.list[EMBRYO], np) == -1)
+      panic("clone: not on embryo list");
+    assertState(np, EMBRYO, __FUNCTION__, __LINE__);
+    np->state = UNUSED;
+    stateListAdd(&ptable.list[UNUSED], np);
+#else
+    np->state = UNUSED;
+#endif // CS333_P3
+    release(&ptable.lock);
+    return -1;
+  }
+  np->tf->esp = sp;
+  np->tf->eip = (uint)fn;
+
+  for(i = 0; i < NOFILE; i++)
+    if(curproc->ofile[i])
+      np->ofile[i] = filedup(curproc->ofile[i]);
+  np->cwd = idup(curproc->cwd);
+
+  safestrcpy(np->name, curproc->name, sizeof(curproc->name));
+#ifdef CS333_P2
+  np->uid = curproc->uid;
+  np->gid = curproc->gid;
+#endif //CS333_P2
+
+  pid = np->pid;
+
+  acquire(&ptable.lock);
+#ifdef CS333_P4
+  if(stateListRemove(&ptable.list[EMBRYO], np) == -1)
+    panic("clone: not on embryo list");
+  assertState(np, EMBRYO, __FUNCTION__, __LINE__);
+  np->state = RUNNABLE;
+  stateListAdd(&ptable.ready[np->priority], np);
+#elif defined(CS333_P3)
+  if(stateListRemove(&ptable.list[EMBRYO], np) == -1)
+    panic("clone: not on embryo list");
+  assertState(np, EMBRYO, __FUNCTION__, __LINE__);
+  np->state = RUNNABLE;
+  stateListAdd(&ptable.list[RUNNABLE], np);
+#else
+  np->state = RUNNABLE;
+#endif // CS333_P4
+  release(&ptable.lock);
+
+  return pid;
+}
+
+// Wait for a clone() thread of the current process to exit,
+// free it, and return its pid, storing its user stack in
+// *stack. Return -1 if this process has no threads.
+int
+join(void **stack)
+{
+  struct proc *p;
+  int havekids;
+  uint pid;
+  struct proc *curproc = myproc();
+
+  acquire(&ptable.lock);
+  for(;;){
+    havekids = 0;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+      if(p->state == UNUSED || p->parent != curproc || !p->thread)
+        continue;
+      havekids = 1;
+      if(p->state != ZOMBIE)
+        continue;
+#ifdef CS333_P3
+      if(stateListRemove(&ptable.list[ZOMBIE], p) == -1)
+        panic("join: not on zombie list");
+      assertState(p, ZOMBIE, __FUNCTION__, __LINE__);
+#endif // CS333_P3
+      pid = p->pid;
+      *stack = p->ustack;
+      kfree(p->kstack);
+      p->kstack = 0;
+      if(!vmshared(p->pgdir, p))
+        freevm(p->pgdir);
+      p->pid = 0;
+      p->parent = 0;
+      p->name[0] = 0;
+      p->killed = 0;
+      p->thread = 0;
+      p->state = UNUSED;
+#ifdef CS333_P3
+      stateListAdd(&ptable.list[UNUSED], p);
+#endif // CS333_P3
+      release(&ptable.lock);
+      return pid;
+    }
+
+    // No point waiting if we don't have any threads.
+    if(!havekids || curproc->killed){
+      release(&ptable.lock);
+      return -1;
+    }
+
+    // Wait for threads to exit.  (See wakeup1 call in exit.)
+    sleep(curproc, &ptable.lock);
+  }
+}
+
 
 #ifdef CS333_P4
 
@@ -645,7 +920,7 @@ wait(void)
       p = ptable.ready[i].head;
       while(p != NULL)
       {
-        if(p->parent != curproc)
+        if(p->parent != curproc || (p->thread && p->pgdir == curproc->pgdir))
         {
           p = p->next;
           continue;
@@ -660,7 +935,7 @@ wait(void)
       p = ptable.list[i].head;
       while(p != NULL)
       {
-        if(p->parent != curproc)
+        if(p->parent != curproc || (p->thread && p->pgdir == curproc->pgdir))
         {
           p = p->next;
           continue;
@@ -676,7 +951,8 @@ wait(void)
           pid = p->pid;
           kfree(p->kstack);
           p->kstack = 0;
-          freevm(p->pgdir);
+          if(!vmshared(p->pgdir, p))
+            freevm(p->pgdir);
           p->pid = 0;
           p->parent = 0;
           p->name[0] = 0;
@@ -723,7 +999,7 @@ wait(void)
       p = ptable.list[i].head;
       while(p != NULL)
       {
-        if(p->parent != curproc)
+        if(p->parent != curproc || (p->thread && p->pgdir == curproc->pgdir))
         {
           p = p->next;
           continue;
@@ -739,7 +1015,8 @@ wait(void)
           pid = p->pid;
           kfree(p->kstack);
           p->kstack = 0;
-          freevm(p->pgdir);
+          if(!vmshared(p->pgdir, p))
+            freevm(p->pgdir);
           p->pid = 0;
           p->parent = 0;
           p->name[0] = 0;
@@ -783,15 +1060,16 @@ wait(void)
     // Scan through table looking for exited children.
     havekids = 0;
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
+      if(p->parent != curproc || (p->thread && p->pgdir == curproc->pgdir))
+        continue;  // threads are for join()
       havekids = 1;
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
         kfree(p->kstack);
         p->kstack = 0;
-        freevm(p->pgdir);
+        if(!vmshared(p->pgdir, p))
+          freevm(p->pgdir);
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
@@ -1092,6 +1370,7 @@ sched(void)
   p->cpu_ticks_total += (ticks - p->cpu_ticks_in);
 #endif //CS333_P2
 
+  fpusave(p);
   swtch(&p->context, mycpu()->scheduler);
   mycpu()->intena = intena;
 }
@@ -1185,6 +1464,9 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    fsmount(ROOTDEV);  // after log recovery
+    if(kthread_create(logflusher, 0, "logflusher") < 0)
+      panic("forkret: logflusher");
   }
 
   // Return to "caller", actually trapret (see allocproc).
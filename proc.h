@@ -8,6 +8,7 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  volatile int tlbwait;        // TLB flush requested by tlbshootdown()
 };
 
 extern struct cpu cpus[NCPU];
@@ -49,6 +50,8 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  int thread;                  // If non-zero, made by clone(): shares parent's pgdir
+  void *ustack;                // User stack given to clone(), returned by join()
   uint start_ticks;            // unsigned int of the start
 #ifdef CS333_P2
   uint uid;                    // uinsigned int of uid
@@ -63,6 +66,8 @@ struct proc {
   int budget;                  //budget for the process - can change
   int priority;                 //priority for the process
 #endif //CS333_P4
+  int fpuused;                 // If non-zero, fpu holds saved FPU state
+  char fpu[512] __attribute__((aligned(16)));  // fxsave area (see fpu.c)
 };
 
 // Process memory is laid out contiguously, low addresses first:
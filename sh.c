@@ -53,6 +53,10 @@ struct backcmd {
 int fork1(void);  // Fork but panics on failure.
 void panic(char*);
 struct cmd *parsecmd(char*);
+void execargv(char**);
+void runline(char*);
+extern char whitespace[];
+extern char symbols[];
 
 // Execute cmd.  Never returns.
 void
@@ -76,8 +80,7 @@ runcmd(struct cmd *cmd)
     ecmd = (struct execcmd*)cmd;
     if(ecmd->argv[0] == 0)
       exit();
-    exec(ecmd->argv[0], ecmd->argv);
-    printf(2, "exec %s failed\n", ecmd->argv[0]);
+    execargv(ecmd->argv);
     break;
 
   case REDIR:
@@ -142,6 +145,342 @@ getcmd(char *buf, int nbuf)
   return 0;
 }
 
+//PAGEBREAK!
+// Builtins run in the shell itself: no fork, and no exec of a
+// program from the file system.  When the line is a plain command
+// they run in the shell's own process; inside a pipeline or a
+// redirection they run in the child forked for it, in place of exec.
+
+#define NVAR 16
+
+struct var {
+  char name[16];
+  char val[64];
+} vars[NVAR];
+
+char cwd[128] = "/";  // tracked by cd, for pwd
+
+struct var*
+lookupvar(char *name)
+{
+  int i;
+
+  for(i = 0; i < NVAR; i++)
+    if(vars[i].name[0] && strcmp(vars[i].name, name) == 0)
+      return &vars[i];
+  return 0;
+}
+
+// Replace each argument of the form $NAME with the variable's value.
+void
+expand(char **argv)
+{
+  struct var *v;
+
+  for(; *argv; argv++)
+    if((*argv)[0] == '$' && (*argv)[1]){
+      v = lookupvar(*argv + 1);
+      *argv = v ? v->val : "";
+    }
+}
+
+// Store in dir the directory cd path leads to from cwd,
+// resolving . and .. components.  Return -1 if it is too long.
+int
+cwdpath(char *path, char *dir)
+{
+  char *p, *q;
+  int n;
+
+  if(*path == '/')
+    strncpy(dir, "/", 2);
+  else
+    strncpy(dir, cwd, sizeof(cwd));
+  n = strlen(dir);
+  for(p = path; *p; p = q){
+    while(*p == '/')
+      p++;
+    for(q = p; *q && *q != '/'; q++)
+      ;
+    if(q == p || (q-p == 1 && p[0] == '.'))
+      continue;
+    if(q-p == 2 && p[0] == '.' && p[1] == '.'){
+      while(n > 1 && dir[n-1] != '/')
+        n--;
+      if(n > 1)
+        n--;
+      dir[n] = 0;
+      continue;
+    }
+    if(n + 1 + (q-p) >= sizeof(cwd))
+      return -1;
+    if(n > 1)
+      dir[n++] = '/';
+    memmove(dir+n, p, q-p);
+    n += q-p;
+    dir[n] = 0;
+  }
+  return 0;
+}
+
+int
+cdbuiltin(int argc, char **argv)
+{
+  char dir[sizeof(cwd)], *path;
+
+  path = argc > 1 ? argv[1] : "/";
+  // Check first, so that cwd always matches the real directory.
+  if(cwdpath(path, dir) < 0){
+    printf(2, "cd: %s: path too long\n", path);
+    return -1;
+  }
+  if(chdir(path) < 0){
+    printf(2, "cannot cd %s\n", path);
+    return -1;
+  }
+  strncpy(cwd, dir, sizeof(cwd));
+  return 0;
+}
+
+int
+echobuiltin(int argc, char **argv)
+{
+  int i;
+
+  for(i = 1; i < argc; i++)
+    printf(1, "%s%s", argv[i], i+1 < argc ? " " : "\n");
+  return 0;
+}
+
+int
+pwdbuiltin(int argc, char **argv)
+{
+  printf(1, "%s\n", cwd);
+  return 0;
+}
+
+int
+exitbuiltin(int argc, char **argv)
+{
+  exit();
+}
+
+// export NAME=value sets a variable; export alone lists them.
+int
+exportbuiltin(int argc, char **argv)
+{
+  struct var *v;
+  char name[sizeof(v->name)], *eq;
+  int i, n;
+
+  if(argc == 1){
+    for(i = 0; i < NVAR; i++)
+      if(vars[i].name[0])
+        printf(1, "%s=%s\n", vars[i].name, vars[i].val);
+    return 0;
+  }
+  for(i = 1; i < argc; i++){
+    if((eq = strchr(argv[i], '=')) == 0 || eq == argv[i] ||
+       eq - argv[i] >= sizeof(v->name) || strlen(eq+1) >= sizeof(v->val)){
+      printf(2, "export: bad assignment %s\n", argv[i]);
+      return -1;
+    }
+    // argv[i] may be a variable's value (see expand), so copy
+    // rather than splitting it in place.
+    n = eq - argv[i];
+    memmove(name, argv[i], n);
+    name[n] = 0;
+    if((v = lookupvar(name)) == 0){
+      for(v = vars; v < &vars[NVAR] && v->name[0]; v++)
+        ;
+      if(v == &vars[NVAR]){
+        printf(2, "export: too many variables\n");
+        return -1;
+      }
+      strncpy(v->name, name, sizeof(v->name));
+    }
+    memmove(v->val, eq+1, strlen(eq+1)+1);
+  }
+  return 0;
+}
+
+// time command: run command and report how long it took.
+int
+timebuiltin(int argc, char **argv)
+{
+  int start;
+
+  start = uptime();
+  if(argc > 1){
+    if(fork1() == 0)
+      execargv(argv+1);
+    wait();
+  }
+  printf(2, "%d ticks\n", uptime() - start);
+  return 0;
+}
+
+struct builtin {
+  char *name;
+  int (*fn)(int, char**);
+} builtins[] = {
+  {"cd", cdbuiltin},
+  {"echo", echobuiltin},
+  {"exit", exitbuiltin},
+  {"export", exportbuiltin},
+  {"pwd", pwdbuiltin},
+  {"time", timebuiltin},
+};
+
+struct builtin*
+findbuiltin(char *name)
+{
+  int i;
+
+  for(i = 0; i < sizeof(builtins)/sizeof(builtins[0]); i++)
+    if(strcmp(name, builtins[i].name) == 0)
+      return &builtins[i];
+  return 0;
+}
+
+// Run argv as a builtin or a program.  Never returns.
+void
+execargv(char **argv)
+{
+  struct builtin *b;
+  int argc;
+
+  expand(argv);
+  if((b = findbuiltin(argv[0])) != 0){
+    for(argc = 0; argv[argc]; argc++)
+      ;
+    b->fn(argc, argv);
+    exit();
+  }
+  exec(argv[0], argv);
+  printf(2, "exec %s failed\n", argv[0]);
+  exit();
+}
+
+#define MAXSTAGE 8
+
+// Run buf without parsing it if it is a simple command or
+// pipeline: words and |, no redirection, lists or grouping.
+// A single builtin runs in the shell's own process.  Otherwise
+// the shell forks each stage itself and waits for all of them,
+// so no process sits between the shell and the stages.
+// "time" followed by any command line times the whole line.
+// Returns 0 if buf must be forked and parsed.
+int
+runsimple(char *buf)
+{
+  static char line[100];
+  static char *argv[MAXSTAGE][MAXARGS];
+  char *q;
+  struct builtin *b;
+  int argc, n, i, in, p[2], pid, start;
+
+  for(q = buf; *q && strchr(whitespace, *q); q++)
+    ;
+  if(strncmp(q, "time", 4) == 0 && q[4] && strchr(whitespace, q[4])){
+    start = uptime();
+    runline(q+4);
+    printf(2, "%d ticks\n", uptime() - start);
+    return 1;
+  }
+  for(; *q; q++)
+    if(*q != '|' && strchr(symbols, *q))
+      return 0;
+
+  strncpy(line, buf, sizeof(line));
+  line[sizeof(line)-1] = 0;
+  n = argc = 0;
+  for(q = line; ; ){
+    while(*q && strchr(whitespace, *q))
+      *q++ = 0;
+    if(*q == 0 || *q == '|'){
+      if(argc == 0 && (*q == '|' || n > 0))
+        return 0;  // empty stage: let the parser report it
+      argv[n++][argc] = 0;
+      argc = 0;
+      if(*q == 0)
+        break;
+      *q++ = 0;
+      if(n == MAXSTAGE)
+        return 0;
+      continue;
+    }
+    if(argc == MAXARGS-1)
+      return 0;
+    argv[n][argc++] = q;
+    while(*q && *q != '|' && !strchr(whitespace, *q))
+      q++;
+  }
+  if(argv[0][0] == 0)
+    return 1;  // blank line
+
+  if(n == 1 && (b = findbuiltin(argv[0][0])) != 0){
+    expand(argv[0]);
+    for(argc = 0; argv[0][argc]; argc++)
+      ;
+    b->fn(argc, argv[0]);
+    return 1;
+  }
+  // Out of pipes or processes: report it, reap the stages already
+  // started, and go back to the prompt rather than exiting.
+  in = -1;
+  for(i = 0; i < n; i++){
+    if(i+1 < n && pipe(p) < 0){
+      printf(2, "pipe failed\n");
+      break;
+    }
+    if((pid = fork()) < 0){
+      printf(2, "fork failed\n");
+      if(i+1 < n){
+        close(p[0]);
+        close(p[1]);
+      }
+      break;
+    }
+    if(pid == 0){
+      if(in >= 0){
+        close(0);
+        dup(in);
+        close(in);
+      }
+      if(i+1 < n){
+        close(1);
+        dup(p[1]);
+        close(p[0]);
+        close(p[1]);
+      }
+      execargv(argv[i]);
+    }
+    if(in >= 0)
+      close(in);
+    in = -1;
+    if(i+1 < n){
+      close(p[1]);
+      in = p[0];
+    }
+  }
+  if(in >= 0)
+    close(in);
+  while(i-- > 0)
+    wait();
+  return 1;
+}
+
+void
+runline(char *buf)
+{
+  if(runsimple(buf))
+    return;
+  if(fork1() == 0)
+    runcmd(parsecmd(buf));
+  wait();
+}
+
 #ifdef USE_BUILTINS
 // ***** processing for shell builtins begins here *****
 int
@@ -229,31 +568,15 @@ main(void)
   }
 
   // Read and run input commands.
+  // cd, exit and the other builtins are handled by runline().
   while(getcmd(buf, sizeof(buf)) >= 0){
-// add support for built-ins here. cd is a built-in
-    if(buf[0] == 'c' && buf[1] == 'd' && buf[2] == ' '){
-      // Clumsy but will have to do for now.
-      // Chdir has no effect on the parent if run in the child.
-      buf[strlen(buf)-1] = 0;  // chop \n
-      if(chdir(buf+3) < 0)
-        printf(2, "cannot cd %s\n", buf+3);
-      continue;
-    }
-#ifdef PDX_XV6
-    // control-d no longer exits the shell, so add 'exit' command
-    if ((buf[0] != '\n') && (strncmp(buf, "exit", strlen(buf)-1) == 0)) { // ignore '\n'
-      exit();
-    }
-#endif // PDX_XV6
 #ifdef USE_BUILTINS
     if (buf[0]=='_') {     // assume it is a builtin command
       dobuiltin(buf);
       continue;
     }
 #endif
-    if(fork1() == 0)
-      runcmd(parsecmd(buf));
-    wait();
+    runline(buf);
   }
   exit();
 }
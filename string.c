@@ -1,14 +1,41 @@
 #include "types.h"
+#include "defs.h"
+#include "mmu.h"
 #include "x86.h"
 
+// Copies of at least SSEMIN bytes use the SSE registers when the
+// CPU has SSE2; below that, saving the FPU state costs more than
+// it gains over rep movsl.
+#define SSEMIN 1024
+
+static int sse2;  // set by stringinit()
+
+// Select the SSE2 copy once fpuinit() has enabled SSE.
+void
+stringinit(void)
+{
+  if((cpufeatures() & CPUID_SSE2) && (rcr4() & CR4_OSFXSR))
+    sse2 = 1;
+}
+
 void*
 memset(void *dst, int c, uint n)
 {
-  if ((int)dst%4 == 0 && n%4 == 0){
-    c &= 0xFF;
-    stosl(dst, (c<<24)|(c<<16)|(c<<8)|c, n/4);
-  } else
-    stosb(dst, c, n);
+  char *d;
+  uint m;
+
+  d = dst;
+  c &= 0xFF;
+  if(n >= 16){
+    m = -(uint)d & 3;
+    stosb(d, c, m);
+    d += m;
+    n -= m;
+    stosl(d, (c<<24)|(c<<16)|(c<<8)|c, n/4);
+    d += n & ~3;
+    n &= 3;
+  }
+  stosb(d, c, n);
   return dst;
 }
 
@@ -19,6 +46,9 @@ memcmp(const void *v1, const void *v2, uint n)
 
   s1 = v1;
   s2 = v2;
+  // Skip equal words; the byte loop finds the difference.
+  while(n >= 4 && *(uint*)s1 == *(uint*)s2)
+    s1 += 4, s2 += 4, n -= 4;
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -28,11 +58,38 @@ memcmp(const void *v1, const void *v2, uint n)
   return 0;
 }
 
+// Copy n bytes forward with the SSE registers, 64 at a time.
+static void
+ssecopy(char *d, const char *s, uint n)
+{
+  uint m;
+
+  m = -(uint)d & 15;
+  movsb(d, s, m);
+  d += m;
+  s += m;
+  n -= m;
+  kfpubegin();
+  for(; n >= 64; n -= 64, s += 64, d += 64)
+    asm volatile("movdqu (%0), %%xmm0\n\t"
+                 "movdqu 16(%0), %%xmm1\n\t"
+                 "movdqu 32(%0), %%xmm2\n\t"
+                 "movdqu 48(%0), %%xmm3\n\t"
+                 "movdqa %%xmm0, (%1)\n\t"
+                 "movdqa %%xmm1, 16(%1)\n\t"
+                 "movdqa %%xmm2, 32(%1)\n\t"
+                 "movdqa %%xmm3, 48(%1)"
+                 : : "r" (s), "r" (d) : "memory");
+  kfpuend();
+  movsb(d, s, n);
+}
+
 void*
 memmove(void *dst, const void *src, uint n)
 {
   const char *s;
   char *d;
+  uint m;
 
   s = src;
   d = dst;
@@ -41,10 +98,25 @@ memmove(void *dst, const void *src, uint n)
     d += n;
     while(n-- > 0)
       *--d = *--s;
-  } else
-    while(n-- > 0)
-      *d++ = *s++;
-
+    return dst;
+  }
+  if(n >= SSEMIN && sse2 && (d + n <= s || s + n <= d)){
+    ssecopy(d, s, n);
+    return dst;
+  }
+  // Forward, so rep movs is safe even if the buffers overlap.
+  if(n >= 16 && ((uint)s & 3) == ((uint)d & 3)){
+    m = -(uint)d & 3;
+    movsb(d, s, m);
+    d += m;
+    s += m;
+    n -= m;
+    movsl(d, s, n/4);
+    d += n & ~3;
+    s += n & ~3;
+    n &= 3;
+  }
+  movsb(d, s, n);
   return dst;
 }
 
@@ -0,0 +1,170 @@
+// Tests and timing for the ulib.c string and memory routines.
+#include "types.h"
+#include "user.h"
+
+#define ROUNDS 2000
+
+static char a[1024], b[1024];
+
+// Simple byte-at-a-time versions to check against.
+static uint
+slowstrlen(char *s)
+{
+  uint n;
+
+  for(n = 0; s[n]; n++)
+    ;
+  return n;
+}
+
+static int
+sign(int x)
+{
+  return x < 0 ? -1 : x > 0;
+}
+
+static int
+slowstrcmp(char *p, char *q)
+{
+  while(*p && *p == *q)
+    p++, q++;
+  return (uchar)*p - (uchar)*q;
+}
+
+static void
+fill(char *p, int n, int seed)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    p[i] = 'a' + (i*7 + seed) % 23;
+}
+
+static int
+teststrings(void)
+{
+  int oa, ob, n, i;
+  char *p, *q;
+
+  for(oa = 0; oa < 4; oa++)
+  for(ob = 0; ob < 4; ob++)
+  for(n = 0; n < 40; n++){
+    p = a + oa;
+    q = b + ob;
+    fill(p, n, 0);
+    p[n] = 0;
+    memmove(q, p, n+1);
+    if(strlen(p) != n || strlen(q) != slowstrlen(q)){
+      printf(2, "FAILED: strlen of %d bytes at +%d\n", n, oa);
+      return -1;
+    }
+    if(strcmp(p, q) != 0){
+      printf(2, "FAILED: strcmp equal, %d bytes at +%d/+%d\n", n, oa, ob);
+      return -1;
+    }
+    for(i = 0; i < n; i++){
+      q[i]++;
+      if(sign(strcmp(p, q)) != sign(slowstrcmp(p, q))){
+        printf(2, "FAILED: strcmp differs at %d of %d\n", i, n);
+        return -1;
+      }
+      q[i]--;
+    }
+    for(i = 0; i < n; i++)
+      if(strchr(p, p[i]) > p + i || *strchr(p, p[i]) != p[i]){
+        printf(2, "FAILED: strchr %c in %d bytes at +%d\n", p[i], n, oa);
+        return -1;
+      }
+    if(strchr(p, 'A') != 0 || (n > 0 && memchr(p, 'A', n) != 0)){
+      printf(2, "FAILED: strchr/memchr found a missing byte\n");
+      return -1;
+    }
+    if(n > 0 && memchr(p, p[n-1], n) != strchr(p, p[n-1])){
+      printf(2, "FAILED: memchr and strchr disagree\n");
+      return -1;
+    }
+  }
+  memset(a, 'x', 8);
+  strncpy(a, "abc", 6);
+  if(strcmp(a, "abc") != 0 || a[4] != 0 || a[5] != 0 || a[6] != 'x'){
+    printf(2, "FAILED: strncpy does not pad\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int
+testmemory(void)
+{
+  int off, n, i;
+
+  for(off = 0; off < 8; off++)
+  for(n = 0; n < 100; n += 3){
+    fill(a, sizeof(a), off);
+    memset(a + off, 'Z', n);
+    for(i = 0; i < n; i++)
+      if(a[off+i] != 'Z'){
+        printf(2, "FAILED: memset %d bytes at +%d\n", n, off);
+        return -1;
+      }
+    if(a[off+n] == 'Z' || (off > 0 && a[off-1] == 'Z')){
+      printf(2, "FAILED: memset %d bytes at +%d overran\n", n, off);
+      return -1;
+    }
+    // Overlapping copies in both directions.
+    fill(a, sizeof(a), 0);
+    memmove(a + off, a + 8, n);
+    fill(b, sizeof(b), 0);
+    for(i = 0; i < n; i++)
+      if(a[off+i] != b[8+i]){
+        printf(2, "FAILED: memmove down %d bytes to +%d\n", n, off);
+        return -1;
+      }
+    fill(a, sizeof(a), 0);
+    memmove(a + 8 + off, a + 3, n);
+    for(i = 0; i < n; i++)
+      if(a[8+off+i] != b[3+i]){
+        printf(2, "FAILED: memmove up %d bytes to +%d\n", n, 8+off);
+        return -1;
+      }
+  }
+  return 0;
+}
+
+static void
+timing(void)
+{
+  int i, start;
+  uint n;
+
+  fill(a, sizeof(a)-1, 0);
+  a[sizeof(a)-1] = 0;
+  n = 0;
+  start = uptime();
+  for(i = 0; i < ROUNDS*10; i++)
+    n += strlen(a) + (strchr(a, '!') != 0);
+  printf(1, "strlen+strchr of %d bytes: %d ticks for %d calls\n",
+      sizeof(a)-1, uptime() - start, ROUNDS*10);
+  start = uptime();
+  for(i = 0; i < ROUNDS*10; i++)
+    memmove(b, a, sizeof(a));
+  printf(1, "memmove of %d bytes: %d ticks for %d calls\n",
+      sizeof(a), uptime() - start, ROUNDS*10);
+  if(n == 0)
+    printf(1, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fail = 0;
+
+  if(teststrings() < 0)
+    fail = 1;
+  if(testmemory() < 0)
+    fail = 1;
+  if(!fail)
+    printf(1, "** string tests passed! **\n");
+  timing();
+  exit();
+}
@@ -0,0 +1,51 @@
+// Microbenchmark for the fixed cost of a system call, comparing
+// the usys.S stubs (sysenter when available) with the trap gate.
+#include "types.h"
+#include "user.h"
+#include "syscall.h"
+#include "traps.h"
+#include "memlayout.h"
+#include "date.h"
+#include "kdata.h"
+
+#define ROUNDS 100000
+
+// sleep(0) returns at once but always enters the kernel.
+static int
+intsleep0(void)
+{
+  int r;
+
+  asm volatile("pushl $0; pushl $0; int %2; addl $8, %%esp"
+               : "=a" (r) : "a" (SYS_sleep), "i" (T_SYSCALL) : "memory", "cc");
+  return r;
+}
+
+static void
+report(char *what, int t)
+{
+  printf(1, "%s: %d calls in %d ticks", what, ROUNDS, t);
+  if(t > 0)
+    printf(1, " (%d calls/tick)", ROUNDS/t);
+  printf(1, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, start;
+
+  printf(1, "sysenter %s\n",
+      ((struct kdata*)UKDATA)->sysenter ? "available" : "not available");
+
+  start = uptime();
+  for(i = 0; i < ROUNDS; i++)
+    intsleep0();
+  report("int $T_SYSCALL", uptime() - start);
+
+  start = uptime();
+  for(i = 0; i < ROUNDS; i++)
+    sleep(0);
+  report("usys stub", uptime() - start);
+  exit();
+}
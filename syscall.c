@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "batch.h"
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -103,6 +104,11 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_batch(void);
+extern int sys_clone(void);
+extern int sys_join(void);
+extern int sys_futex_wait(void);
+extern int sys_futex_wake(void);
 #ifdef PDX_XV6
 extern int sys_halt(void);
 #endif // PDX_XV6
@@ -144,6 +150,11 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_batch]   sys_batch,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
 #ifdef PDX_XV6
 [SYS_halt]    sys_halt,
 #endif // PDX_XV6
@@ -187,6 +198,11 @@ static char *syscallnames[] = {
   [SYS_link]    "link",
   [SYS_mkdir]   "mkdir",
   [SYS_close]   "close",
+  [SYS_batch]   "batch",
+  [SYS_clone]   "clone",
+  [SYS_join]    "join",
+  [SYS_futex_wait] "futex_wait",
+  [SYS_futex_wake] "futex_wake",
 #ifdef PDX_XV6
   [SYS_halt]    "halt",
 #ifdef CS333_P1
@@ -196,6 +212,61 @@ static char *syscallnames[] = {
 };
 #endif // PRINT_SYSCALLS
 
+// Calls that rebuild or copy the trap frame cannot run inside a
+// batch: the frame's %esp points into the batch array while they run.
+static int
+batchable(int num)
+{
+  return num != SYS_fork && num != SYS_exec && num != SYS_batch &&
+      num != SYS_clone;
+}
+
+// Run up to n system calls described by a user array of struct
+// batchent in a single kernel entry, storing each result in the
+// entry's ret field. Stops early at an invalid entry or if the
+// process is killed. Returns the number of entries run.
+int
+sys_batch(void)
+{
+  struct batchent *b;
+  struct proc *curproc = myproc();
+  uint esp;
+  int i, n, num, ret;
+
+  if(argint(1, &n) < 0 || n < 0 || n > MAXBATCH)
+    return -1;
+  if(argptr(0, (void*)&b, n*sizeof(*b)) < 0)
+    return -1;
+
+  esp = curproc->tf->esp;
+  for(i = 0; i < n && !curproc->killed; i++){
+    num = b[i].num;
+    if(num <= 0 || num >= NELEM(syscalls) || !syscalls[num] || !batchable(num)){
+      b[i].ret = -1;
+      break;
+    }
+    // Point the saved user stack at this entry so argint() and
+    // friends fetch its arguments.
+    curproc->tf->esp = (uint)&b[i];
+    ret = syscalls[num]();
+#if defined(PRINT_SYSCALLS)
+    cprintf("\n%s", syscallnames[num]);
+    cprintf(" -> %d", ret);
+#endif //PRINT_SYSCALLS
+    // An sbrk() in the batch may have shrunk memory under the
+    // array; stop before touching an entry that is gone.
+    if((uint)(b+n) > curproc->sz){
+      if((uint)(b+i+1) <= curproc->sz)
+        b[i].ret = ret;
+      i++;
+      break;
+    }
+    b[i].ret = ret;
+  }
+  curproc->tf->esp = esp;
+  return i;
+}
+
 void
 syscall(void)
 {
@@ -31,3 +31,8 @@
 #define SYS_getprocs SYS_setgid+1
 #define SYS_setpriority SYS_getprocs+1
 #define SYS_getpriority SYS_setpriority+1
+#define SYS_batch   SYS_getpriority+1
+#define SYS_clone   SYS_batch+1
+#define SYS_join    SYS_clone+1
+#define SYS_futex_wait SYS_join+1
+#define SYS_futex_wake SYS_futex_wait+1
@@ -218,6 +218,7 @@ sys_unlink(void)
   memset(&de, 0, sizeof(de));
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
+  dcput(dp, name, 0, 0);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -264,6 +265,8 @@ create(char *path, short type, short major, short minor)
   ilock(ip);
   ip->major = major;
   ip->minor = minor;
+  if(type == T_DIR)
+    ip->minor = 1;  // hashed, one bucket to start (see fs.h)
   ip->nlink = 1;
   iupdate(ip);
 
@@ -297,7 +300,7 @@ sys_open(void)
   begin_op();
 
   if(omode & O_CREATE){
-    ip = create(path, T_FILE, 0, 0);
+    ip = create(path, T_FILE, 0, (omode & O_EXTENT) ? IF_EXTENT : 0);
     if(ip == 0){
       end_op();
       return -1;
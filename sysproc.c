@@ -42,6 +42,48 @@ sys_kill(void)
   return kill(pid);
 }
 
+int
+sys_clone(void)
+{
+  int fn, arg;
+  char *stack;
+
+  if(argint(0, &fn) < 0 || argint(1, &arg) < 0 ||
+     argptr(2, &stack, PGSIZE) < 0)
+    return -1;
+  return clone((void(*)(void*))fn, (void*)arg, stack);
+}
+
+int
+sys_join(void)
+{
+  void **stack;
+
+  if(argptr(0, (void*)&stack, sizeof(*stack)) < 0)
+    return -1;
+  return join(stack);
+}
+
+int
+sys_futex_wait(void)
+{
+  int addr, val;
+
+  if(argint(0, &addr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futexwait(addr, val);
+}
+
+int
+sys_futex_wake(void)
+{
+  int addr, n;
+
+  if(argint(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futexwake(addr, n);
+}
+
 int
 sys_getpid(void)
 {
@@ -51,13 +93,12 @@ sys_getpid(void)
 int
 sys_sbrk(void)
 {
-  int addr;
+  uint addr;
   int n;
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if(growproc(n, &addr) < 0)
     return -1;
   return addr;
 }
@@ -111,7 +152,7 @@ sys_date(void)
     return -1;
   else
   {
-    cmostime(d);
+    readkdate(d);
     return 0;
   }
 }
@@ -152,6 +193,7 @@ sys_setuid(void)
   else 
   {
     myproc()->uid = new_uid;
+    setudata(myproc());
     return 0;
   }
 }
@@ -173,6 +215,7 @@ sys_setgid(void)
   else 
   {
     myproc()->gid = new_gid;
+    setudata(myproc());
     return 0;
   }
 }
@@ -0,0 +1,213 @@
+// Tests for clone()/join(), futexes and the uthread.c library.
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NTHREAD 8
+#define ROUNDS 20000
+#define NGROW 8
+
+static struct lock lk;
+static struct mutex mu;
+static volatile int counter, mcounter;
+static volatile int sum[NTHREAD];
+static char *grown[NTHREAD][NGROW], *allocd[NTHREAD][NGROW];
+static int sharefd, threadfd;
+
+static void
+worker(void *arg)
+{
+  int i, id = (int)arg;
+
+  for(i = 0; i < ROUNDS; i++){
+    lock_acquire(&lk);
+    counter++;
+    lock_release(&lk);
+    mutex_lock(&mu);
+    mcounter++;
+    mutex_unlock(&mu);
+    sum[id] += i;
+  }
+}
+
+// Grow memory from every thread at once: with sbrk() directly,
+// and with malloc(), which is not thread-safe, under a mutex.
+static void
+grower(void *arg)
+{
+  int k, id = (int)arg;
+  char *p;
+
+  for(k = 0; k < NGROW; k++){
+    if((p = sbrk(4096)) == (char*)-1)
+      return;
+    memset(p, 'a' + id, 4096);
+    grown[id][k] = p;
+    mutex_lock(&mu);
+    p = malloc(100);
+    mutex_unlock(&mu);
+    if(p == 0)
+      return;
+    memset(p, 'A' + id, 100);
+    allocd[id][k] = p;
+  }
+}
+
+// Check that no two threads were handed the same memory.
+static int
+testgrow(void)
+{
+  int i, k, j;
+  void *stack;
+
+  // Stacks are malloc()ed and free()d too.
+  mutex_lock(&mu);
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_create(grower, (void*)i) < 0){
+      printf(2, "FAILED: thread_create %d\n", i);
+      return -1;
+    }
+  }
+  mutex_unlock(&mu);
+  while(join(&stack) > 0){
+    mutex_lock(&mu);
+    free(stack);
+    mutex_unlock(&mu);
+  }
+  for(i = 0; i < NTHREAD; i++){
+    for(k = 0; k < NGROW; k++){
+      if(grown[i][k] == 0 || allocd[i][k] == 0){
+        printf(2, "FAILED: thread %d could not grow memory\n", i);
+        return -1;
+      }
+      for(j = 0; j < 4096; j++){
+        if(grown[i][k][j] != 'a' + i){
+          printf(2, "FAILED: sbrk gave threads overlapping memory\n");
+          return -1;
+        }
+      }
+      for(j = 0; j < 100; j++){
+        if(allocd[i][k][j] != 'A' + i){
+          printf(2, "FAILED: malloc gave threads overlapping memory\n");
+          return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+// A thread gets copies of its creator's descriptors and cwd, as
+// fork() gives: the open files themselves are shared, but opening,
+// closing or chdir in one thread does not change the others.
+static void
+fdworker(void *arg)
+{
+  write(sharefd, "b", 1);
+  threadfd = open("threadtest.tmp", O_RDONLY);
+  chdir("threadtest.d");
+}
+
+static int
+testfiles(void)
+{
+  char buf[4];
+  int fd;
+
+  if(mkdir("threadtest.d") < 0 ||
+     (sharefd = open("threadtest.tmp", O_CREATE|O_RDWR)) < 0){
+    printf(2, "FAILED: cannot create threadtest.tmp\n");
+    return -1;
+  }
+  write(sharefd, "a", 1);
+  if(thread_create(fdworker, 0) < 0 || thread_join() < 0){
+    printf(2, "FAILED: fd thread\n");
+    return -1;
+  }
+  write(sharefd, "c", 1);
+  close(sharefd);
+  if(threadfd < 0 || read(threadfd, buf, 1) != -1){
+    printf(2, "FAILED: thread's new fd appeared in its creator\n");
+    return -1;
+  }
+  if((fd = open("threadtest.tmp", O_RDONLY)) < 0){
+    printf(2, "FAILED: thread's chdir moved its creator\n");
+    return -1;
+  }
+  if(read(fd, buf, sizeof(buf)) != 3 || buf[0] != 'a' || buf[1] != 'b' ||
+     buf[2] != 'c'){
+    printf(2, "FAILED: thread did not share the open file's offset\n");
+    return -1;
+  }
+  close(fd);
+  unlink("threadtest.tmp");
+  unlink("threadtest.d");
+  return 0;
+}
+
+static int
+testfutex(void)
+{
+  volatile uint word = 1;
+
+  if(futex_wait(&word, 0) != -1){
+    printf(2, "FAILED: futex_wait slept on a changed word\n");
+    return -1;
+  }
+  if(futex_wake(&word, 1) != 0){
+    printf(2, "FAILED: futex_wake woke a nonexistent waiter\n");
+    return -1;
+  }
+  if(futex_wait((uint*)0x7ffffff0, 0) != -1){
+    printf(2, "FAILED: futex_wait accepted a bad address\n");
+    return -1;
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, start;
+  char *p;
+
+  if(testfutex() < 0)
+    exit();
+  lock_init(&lk);
+  mutex_init(&mu);
+  start = uptime();
+  for(i = 0; i < NTHREAD; i++){
+    if(thread_create(worker, (void*)i) < 0){
+      printf(2, "FAILED: thread_create %d\n", i);
+      exit();
+    }
+  }
+  // Memory grown by one thread is visible to the others.
+  p = sbrk(4096);
+  p[0] = 'x';
+  for(n = 0; thread_join() > 0; n++)
+    ;
+  if(n != NTHREAD){
+    printf(2, "FAILED: joined %d of %d threads\n", n, NTHREAD);
+    exit();
+  }
+  if(counter != NTHREAD*ROUNDS || mcounter != NTHREAD*ROUNDS){
+    printf(2, "FAILED: counters %d and %d, want %d\n", counter, mcounter,
+        NTHREAD*ROUNDS);
+    exit();
+  }
+  for(i = 0; i < NTHREAD; i++){
+    if(sum[i] != (ROUNDS-1)*ROUNDS/2){
+      printf(2, "FAILED: thread %d summed %d\n", i, sum[i]);
+      exit();
+    }
+  }
+  if(wait() != -1){
+    printf(2, "FAILED: wait() found a thread\n");
+    exit();
+  }
+  if(testgrow() < 0 || testfiles() < 0)
+    exit();
+  printf(1, "** thread tests passed! ** (%d ticks)\n", uptime() - start);
+  exit();
+}
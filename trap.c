@@ -11,6 +11,7 @@
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
+extern void sysentry(void);  // in trapasm.S
 #ifdef PDX_XV6
 // set alignment to 32-bit for ticks. See Intel® 64 and IA-32 Architectures
 // Software Developer’s Manual, Vol 3A, 8.1.1 Guaranteed Atomic Operations.
@@ -54,6 +55,10 @@ trap(struct trapframe *tf)
     return;
   }
 
+  // First FPU instruction since the process was switched in.
+  if(tf->trapno == T_DEVICE && (tf->cs&3) == DPL_USER && fputrap() == 0)
+    return;
+
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
     if(cpuid() == 0){
@@ -66,9 +71,14 @@ trap(struct trapframe *tf)
       wakeup(&ticks);
       release(&tickslock);
 #endif // PDX_XV6
+      updatekdata();
     }
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_TLB:
+    tlbintr();
+    lapiceoi();
+    break;
   case T_IRQ0 + IRQ_IDE:
     ideintr();
     lapiceoi();
@@ -93,6 +103,12 @@ trap(struct trapframe *tf)
 
   //PAGEBREAK: 13
   default:
+    if(tf->trapno == T_DEBUG && (tf->cs&3) == 0 && tf->eip == (uint)sysentry){
+      // sysenter keeps the trap flag, so a user program that set it
+      // single-steps into sysentry. Drop the flag and carry on.
+      tf->eflags &= ~FL_TF;
+      break;
+    }
     if(myproc() == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
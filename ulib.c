@@ -3,6 +3,9 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "memlayout.h"
+#include "date.h"
+#include "kdata.h"
 
 char*
 strcpy(char *s, char *t)
@@ -15,9 +18,37 @@ strcpy(char *s, char *t)
   return os;
 }
 
+// The string routines below look at a word at a time once their
+// pointers are word aligned. An aligned word never crosses a page
+// boundary, so reading past the end of a string within one is safe.
+#define ONES    0x01010101
+#define HIGHS   0x80808080
+// Non-zero if some byte of w is zero.
+#define HASZERO(w) (((w) - ONES) & ~(w) & HIGHS)
+
+char*
+strncpy(char *s, const char *t, int n)
+{
+  char *os;
+
+  os = s;
+  while(n-- > 0 && (*s++ = *t++) != 0)
+    ;
+  while(n-- > 0)
+    *s++ = 0;
+  return os;
+}
+
 int
 strcmp(const char *p, const char *q)
 {
+  if((((uint)p ^ (uint)q) & 3) == 0){
+    for(; (uint)p & 3; p++, q++)
+      if(*p == 0 || *p != *q)
+        return (uchar)*p - (uchar)*q;
+    while(*(uint*)p == *(uint*)q && !HASZERO(*(uint*)p))
+      p += 4, q += 4;
+  }
   while(*p && *p == *q)
     p++, q++;
   return (uchar)*p - (uchar)*q;
@@ -26,29 +57,83 @@ strcmp(const char *p, const char *q)
 uint
 strlen(char *s)
 {
-  int n;
+  char *p;
 
-  for(n = 0; s[n]; n++)
-    ;
-  return n;
+  for(p = s; (uint)p & 3; p++)
+    if(*p == 0)
+      return p - s;
+  while(!HASZERO(*(uint*)p))
+    p += 4;
+  while(*p)
+    p++;
+  return p - s;
 }
 
 void*
 memset(void *dst, int c, uint n)
 {
-  stosb(dst, c, n);
+  char *d;
+  uint m;
+
+  d = dst;
+  c &= 0xFF;
+  if(n >= 16){
+    m = -(uint)d & 3;
+    stosb(d, c, m);
+    d += m;
+    n -= m;
+    stosl(d, c * ONES, n/4);
+    d += n & ~3;
+    n &= 3;
+  }
+  stosb(d, c, n);
   return dst;
 }
 
 char*
 strchr(const char *s, char c)
 {
+  uint w, cw;
+
+  for(; (uint)s & 3; s++){
+    if(*s == 0)
+      return 0;
+    if(*s == c)
+      return (char*)s;
+  }
+  cw = (uchar)c * ONES;
+  for(;;){
+    w = *(uint*)s;
+    if(HASZERO(w) || HASZERO(w ^ cw))
+      break;
+    s += 4;
+  }
   for(; *s; s++)
     if(*s == c)
       return (char*)s;
   return 0;
 }
 
+void*
+memchr(const void *v, int c, uint n)
+{
+  const uchar *s;
+  uint cw;
+
+  s = v;
+  c &= 0xFF;
+  for(; n > 0 && ((uint)s & 3); s++, n--)
+    if(*s == c)
+      return (void*)s;
+  cw = c * ONES;
+  for(; n >= 4 && !HASZERO(*(uint*)s ^ cw); s += 4, n -= 4)
+    ;
+  for(; n > 0; s++, n--)
+    if(*s == c)
+      return (void*)s;
+  return 0;
+}
+
 char*
 gets(char *buf, int max)
 {
@@ -138,10 +223,122 @@ void*
 memmove(void *vdst, void *vsrc, int n)
 {
   char *dst, *src;
+  int m;
 
   dst = vdst;
   src = vsrc;
-  while(n-- > 0)
-    *dst++ = *src++;
+  if(src < dst && src + n > dst){
+    dst += n;
+    src += n;
+    while(n-- > 0)
+      *--dst = *--src;
+    return vdst;
+  }
+  // Forward, so rep movs is safe even if the buffers overlap.
+  if(n >= 16 && (((uint)src ^ (uint)dst) & 3) == 0){
+    m = -(uint)dst & 3;
+    movsb(dst, src, m);
+    dst += m;
+    src += m;
+    n -= m;
+    movsl(dst, src, n/4);
+    dst += n & ~3;
+    src += n & ~3;
+    n &= 3;
+  }
+  if(n > 0)
+    movsb(dst, src, n);
   return vdst;
 }
+
+void*
+memcpy(void *dst, void *src, uint n)
+{
+  return memmove(dst, src, n);
+}
+
+// Set by printf.c once it has buffered output, and called with the
+// descriptor about to be closed, or -1 to flush every buffer.
+void (*_flush)(int);
+
+int _fork(void);
+int _exit(void) __attribute__((noreturn));
+int _close(int);
+int _exec(char*, char**);
+
+int
+fork(void)
+{
+  if(_flush)
+    _flush(-1);
+  return _fork();
+}
+
+int
+exit(void)
+{
+  if(_flush)
+    _flush(-1);
+  _exit();
+}
+
+int
+close(int fd)
+{
+  if(_flush)
+    _flush(fd);
+  return _close(fd);
+}
+
+int
+exec(char *path, char **argv)
+{
+  if(_flush)
+    _flush(-1);
+  return _exec(path, argv);
+}
+
+// The calls below read the data pages the kernel maps at the top of
+// every address space (see kdata.h) instead of trapping.
+int
+uptime(void)
+{
+  return ((volatile struct kdata*)UKDATA)->ticks;
+}
+
+int
+getpid(void)
+{
+  return ((volatile struct udata*)UUDATA)->pid;
+}
+
+#ifdef CS333_P1
+int
+date(struct rtcdate *r)
+{
+  volatile struct kdata *k = (struct kdata*)UKDATA;
+  uint seq;
+
+  do {
+    seq = k->dateseq;
+    __sync_synchronize();
+    *r = *(struct rtcdate*)&k->date;
+    __sync_synchronize();
+  } while((seq & 1) || seq != k->dateseq);
+  return 0;
+}
+#endif // CS333_P1
+
+#ifdef CS333_P2
+uint
+getuid(void)
+{
+  return ((volatile struct udata*)UUDATA)->uid;
+}
+
+uint
+getgid(void)
+{
+  return ((volatile struct udata*)UUDATA)->gid;
+}
+#endif // CS333_P2
@@ -3,30 +3,40 @@
 #include "user.h"
 #include "param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Small blocks come from segregated free lists, one per
+// power-of-two size class, refilled a slab at a time from
+// sbrk(); malloc() and free() of them are constant time.
+// Larger blocks use the memory allocator by Kernighan and
+// Ritchie, The C programming Language, 2nd ed.  Section 8.7,
+// fed directly from sbrk().
 
 typedef long Align;
 
 union header {
   struct {
     union header *ptr;
-    uint size;
+    uint size;        // in units of sizeof(Header), header included
   } s;
   Align x;
 };
 
 typedef union header Header;
 
+#define NCLASS 8                   // classes of 2, 4, ... 256 units
+#define MAXSMALL (2 << (NCLASS-1))
+#define SLAB 4096                  // bytes sbrk()ed per refill
+
+static Header *classfree[NCLASS];
+
 static Header base;
 static Header *freep;
 
-void
-free(void *ap)
+// Free a large block into the K&R list.
+static void
+largefree(Header *bp)
 {
-  Header *bp, *p;
+  Header *p;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -43,30 +53,44 @@ free(void *ap)
   freep = p;
 }
 
+void
+free(void *ap)
+{
+  Header *bp;
+  int c;
+
+  bp = (Header*)ap - 1;
+  if(bp->s.size <= MAXSMALL){
+    for(c = 0; (2 << c) != bp->s.size; c++)
+      ;
+    bp->s.ptr = classfree[c];
+    classfree[c] = bp;
+  } else
+    largefree(bp);
+}
+
 static Header*
 morecore(uint nu)
 {
   char *p;
   Header *hp;
 
-  if(nu < 4096)
-    nu = 4096;
+  if(nu < SLAB/sizeof(Header))
+    nu = SLAB/sizeof(Header);
   p = sbrk(nu * sizeof(Header));
   if(p == (char*)-1)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  largefree(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+static void*
+largemalloc(uint nunits)
 {
   Header *p, *prevp;
-  uint nunits;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -88,3 +112,40 @@ malloc(uint nbytes)
         return 0;
   }
 }
+
+// Carve a fresh slab into blocks of class c.
+static int
+refill(int c)
+{
+  Header *p, *end;
+  uint units;
+
+  if((p = (Header*)sbrk(SLAB)) == (Header*)-1)
+    return -1;
+  units = 2 << c;
+  for(end = p + SLAB/sizeof(Header); p + units <= end; p += units){
+    p->s.size = units;
+    p->s.ptr = classfree[c];
+    classfree[c] = p;
+  }
+  return 0;
+}
+
+void*
+malloc(uint nbytes)
+{
+  Header *p;
+  uint nunits;
+  int c;
+
+  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  if(nunits > MAXSMALL)
+    return largemalloc(nunits);
+  for(c = 0; (2 << c) < nunits; c++)
+    ;
+  if(classfree[c] == 0 && refill(c) < 0)
+    return 0;
+  p = classfree[c];
+  classfree[c] = p->s.ptr;
+  return (void*)(p + 1);
+}
@@ -1,6 +1,7 @@
 struct stat;
 struct rtcdate;
 struct uproc;
+struct batchent;
 
 // system calls
 int fork(void);
@@ -25,6 +26,11 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int halt(void);
+int batch(struct batchent*, int);
+int clone(void(*)(void*), void*, void*);
+int join(void**);
+int futex_wait(volatile uint*, uint);
+int futex_wake(volatile uint*, int);
 #ifdef CS333_P1
 int date(struct rtcdate*);
 #endif // CS333_P1
@@ -45,15 +51,35 @@ int getpriority(int pid);
 int stat(char*, struct stat*);
 char* strcpy(char*, char*);
 void *memmove(void*, void*, int);
+void *memcpy(void*, void*, uint);
+void *memchr(const void*, int, uint);
+char* strncpy(char*, const char*, int);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void printf(int, char*, ...);
+void fflush(int);
 char* gets(char*, int max);
 uint strlen(char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+
+// uthread.c
+struct lock {
+  uint locked;
+};
+int thread_create(void(*)(void*), void*);
+int thread_join(void);
+void lock_init(struct lock*);
+void lock_acquire(struct lock*);
+void lock_release(struct lock*);
+struct mutex {
+  uint state;  // 0 unlocked, 1 locked, 2 locked with waiters
+};
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
 #ifdef PDX_XV6
 int atoo(const char*);
 int strncmp(const char*, const char*, uint);
@@ -184,6 +184,8 @@ writetest(void)
   printf(stdout, "small file test ok\n");
 }
 
+#define BIGFILE (NDIRECT + 2*NINDIRECT)
+
 void
 writetest1(void)
 {
@@ -197,7 +199,8 @@ writetest1(void)
     exit();
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  // reach into the double-indirect blocks
+  for(i = 0; i < BIGFILE; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, 512) != 512){
       printf(stdout, "error: write big file failed\n", i);
@@ -217,7 +220,7 @@ writetest1(void)
   for(;;){
     i = read(fd, buf, 512);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n != BIGFILE){
         printf(stdout, "read only %d blocks from big", n);
         exit();
       }
@@ -0,0 +1,122 @@
+// User-level threads on clone()/join(), spin locks, and
+// mutexes that sleep in futex_wait() when contended.
+#include "types.h"
+#include "user.h"
+#include "mmu.h"
+
+static inline uint
+xchg(volatile uint *addr, uint newval)
+{
+  uint result;
+
+  asm volatile("lock; xchgl %0, %1" :
+               "+m" (*addr), "=a" (result) :
+               "1" (newval) :
+               "cc");
+  return result;
+}
+
+static inline uint
+cmpxchg(volatile uint *addr, uint old, uint newval)
+{
+  uint result;
+
+  asm volatile("lock; cmpxchgl %2, %1" :
+               "=a" (result), "+m" (*addr) :
+               "r" (newval), "0" (old) :
+               "cc");
+  return result;
+}
+
+// Threads start here, with fn and arg at the base of their stack.
+static void
+tstart(void *stack)
+{
+  void **a = stack;
+
+  ((void (*)(void*))a[0])(a[1]);
+  exit();
+}
+
+// Start a thread running fn(arg) in this address space, on
+// a malloc()ed stack. Returns its pid, or -1.
+// malloc() is not thread-safe: create threads from one thread
+// or hold a lock.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  void **stack;
+  int pid;
+
+  if((stack = malloc(PGSIZE)) == 0)
+    return -1;
+  stack[0] = fn;
+  stack[1] = arg;
+  if((pid = clone(tstart, stack, stack)) < 0)
+    free(stack);
+  return pid;
+}
+
+// Wait for one of this thread's threads to exit and free its
+// stack. Returns its pid, or -1 if there are none.
+int
+thread_join(void)
+{
+  void *stack;
+  int pid;
+
+  if((pid = join(&stack)) >= 0)
+    free(stack);
+  return pid;
+}
+
+void
+lock_init(struct lock *lk)
+{
+  lk->locked = 0;
+}
+
+void
+lock_acquire(struct lock *lk)
+{
+  while(xchg(&lk->locked, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+void
+lock_release(struct lock *lk)
+{
+  __sync_synchronize();
+  xchg(&lk->locked, 0);
+}
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+// Take the mutex, sleeping in the kernel only if it is held.
+// state 2 tells mutex_unlock() that someone may be asleep.
+void
+mutex_lock(struct mutex *m)
+{
+  uint c;
+
+  if((c = cmpxchg(&m->state, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = xchg(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = xchg(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(xchg(&m->state, 0) == 2)
+    futex_wake(&m->state, 1);
+}
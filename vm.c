@@ -6,9 +6,21 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "date.h"
+#include "kdata.h"
+#include "traps.h"
 
 extern char data[];  // defined by kernel.ld
+extern void sysentry(void);  // in trapasm.S
 pde_t *kpgdir;  // for use in scheduler()
+static uint kfeatures;  // cpufeatures(), sampled by kvmalloc()
+static struct kdata *kdata;  // mapped read-only at UKDATA in every pgdir
+
+#ifdef PDX_XV6
+#define KDATE_TICKS TPS  // refresh kdata->date once a second
+#else
+#define KDATE_TICKS 100
+#endif // PDX_XV6
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -27,6 +39,21 @@ seginit(void)
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
   lgdt(c->gdt, sizeof(c->gdt));
+
+  // Fast system call entry; see sysentry in trapasm.S. sysenter
+  // and sysexit derive the other three selectors from SEG_KCODE,
+  // which the order of the segments above allows. switchuvm()
+  // points MSR_SYSENTER_ESP at each process's kernel stack.
+  if(cpufeatures() & CPUID_SEP){
+    wrmsr(MSR_SYSENTER_CS, SEG_KCODE<<3);
+    wrmsr(MSR_SYSENTER_EIP, (uint)sysentry);
+    kdata->sysenter = 1;
+  }
+
+  // Keep the kernel's TLB entries (PTE_G, see kvmalloc) across
+  // the lcr3() in every switchuvm().
+  if(kfeatures & CPUID_PGE)
+    lcr4(rcr4() | CR4_PGE);
 }
 
 // Return the address of the PTE in page table pgdir
@@ -39,6 +66,8 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   pte_t *pgtab;
 
   pde = &pgdir[PDX(va)];
+  if(*pde & PTE_PS)
+    panic("walkpgdir: 4Mbyte page");
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
@@ -80,15 +109,17 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 }
 
 // There is one page table per process, plus one that's used when
-// a CPU is not running any process (kpgdir). The kernel uses the
-// current process's page table during system calls and interrupts;
-// page protection bits prevent user code from using the kernel's
-// mappings.
+// a CPU is not running any process (kpgdir). The mappings above
+// KERNBASE live in page tables that kpgdir and every process
+// share. The kernel uses the current process's page table during
+// system calls and interrupts; page protection bits prevent user
+// code from using the kernel's mappings.
 //
 // setupkvm() and exec() set up every page table like this:
 //
-//   0..KERNBASE: user memory (text+data+stack+heap), mapped to
+//   0..USERTOP: user memory (text+data+stack+heap), mapped to
 //                phys memory allocated by the kernel
+//   USERTOP..KERNBASE: read-only kernel data pages (see kdata.h)
 //   KERNBASE..KERNBASE+EXTMEM: mapped to 0..EXTMEM (for I/O space)
 //   KERNBASE+EXTMEM..data: mapped to EXTMEM..V2P(data)
 //                for the kernel's instructions and r/o data
@@ -114,33 +145,93 @@ static struct kmap {
  { (void*)DEVSPACE, DEVSPACE,      0,         PTE_W}, // more devices
 };
 
-// Set up kernel part of a page table.
+// Set up kernel part of a page table.  The kernel's page tables
+// are built once, in kpgdir, and every process's page directory
+// points at them; only the directory itself and the page table
+// holding the data pages below KERNBASE are per-process.
 pde_t*
 setupkvm(void)
 {
   pde_t *pgdir;
-  struct kmap *k;
+  char *mem;
 
   if((pgdir = (pde_t*)kalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
-  if (P2V(PHYSTOP) > (void*)DEVSPACE)
-    panic("PHYSTOP too high");
-  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
-    if(mappages(pgdir, k->virt, k->phys_end - k->phys_start,
-                (uint)k->phys_start, k->perm) < 0) {
-      freevm(pgdir);
-      return 0;
-    }
+  memset(pgdir, 0, PDX(KERNBASE)*sizeof(pde_t));
+  memmove(&pgdir[PDX(KERNBASE)], &kpgdir[PDX(KERNBASE)],
+          (NPDENTRIES-PDX(KERNBASE))*sizeof(pde_t));
+
+  // Read-only kernel data pages: one shared, one private.
+  if(mappages(pgdir, (char*)UKDATA, PGSIZE, V2P(kdata), PTE_U) < 0 ||
+     (mem = kalloc()) == 0){
+    freevm(pgdir);
+    return 0;
+  }
+  memset(mem, 0, PGSIZE);
+  if(mappages(pgdir, (char*)UUDATA, PGSIZE, V2P(mem), PTE_U) < 0){
+    kfree(mem);
+    freevm(pgdir);
+    return 0;
+  }
   return pgdir;
 }
 
+// Map kmap entry k into kpgdir with perm added to its own bits,
+// using 4Mbyte pages where both addresses are 4Mbyte aligned if
+// big is set, else 4Kbyte pages.
+static void
+kmapin(struct kmap *k, int big, int perm)
+{
+  uint va, pa, size;
+
+  va = (uint)k->virt;
+  pa = k->phys_start;
+  size = k->phys_end - k->phys_start;
+  perm |= k->perm;
+  while(size > 0){
+    if(big && va % PDSIZE == 0 && pa % PDSIZE == 0 && size >= PDSIZE){
+      if(kpgdir[PDX(va)] & PTE_P)
+        panic("remap");
+      kpgdir[PDX(va)] = pa | perm | PTE_P | PTE_PS;
+      va += PDSIZE;
+      pa += PDSIZE;
+      size -= PDSIZE;
+    } else {
+      if(mappages(kpgdir, (void*)va, PGSIZE, pa, perm) < 0)
+        panic("kvmalloc: kmap");
+      va += PGSIZE;
+      pa += PGSIZE;
+      size -= PGSIZE;
+    }
+  }
+}
+
 // Allocate one page table for the machine for the kernel address
-// space for scheduler processes.
+// space for scheduler processes.  Its kernel half is shared by
+// every page table setupkvm() creates, so it must be complete
+// before the first process exists and never changes after.
 void
 kvmalloc(void)
 {
-  kpgdir = setupkvm();
+  struct kmap *k;
+
+  if((kdata = (struct kdata*)kalloc()) == 0)
+    panic("kvmalloc: kdata");
+  memset(kdata, 0, PGSIZE);
+  cmostime(&kdata->date);
+  if((kpgdir = (pde_t*)kalloc()) == 0)
+    panic("kvmalloc: kpgdir");
+  memset(kpgdir, 0, PGSIZE);
+  if (P2V(PHYSTOP) > (void*)DEVSPACE)
+    panic("PHYSTOP too high");
+  // Physical memory and the device space mostly go in 4Mbyte
+  // pages, which take no page-table pages and far fewer TLB
+  // entries; the first 4Mbytes keep 4Kbyte pages so kernel text
+  // stays read-only.  The kernel map never changes and is the
+  // same in every page table, so it is marked global.
+  kfeatures = cpufeatures();
+  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
+    kmapin(k, kfeatures & CPUID_PSE, (kfeatures & CPUID_PGE) ? PTE_G : 0);
   switchkvm();
 }
 
@@ -160,8 +251,6 @@ switchuvm(struct proc *p)
     panic("switchuvm: no process");
   if(p->kstack == 0)
     panic("switchuvm: no kstack");
-  if(p->pgdir == 0)
-    panic("switchuvm: no pgdir");
 
   pushcli();
   mycpu()->gdt[SEG_TSS] = SEG16(STS_T32A, &mycpu()->ts,
@@ -173,10 +262,67 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
+  if(p->pgdir == 0){  // kernel thread; see kthread_create()
+    lcr3(V2P(kpgdir));
+    popcli();
+    return;
+  }
+  if(kdata->sysenter)
+    wrmsr(MSR_SYSENTER_ESP, (uint)p->kstack + KSTACKSIZE);
+  if(!p->thread)  // threads share their process's page
+    setudata(p);
   lcr3(V2P(p->pgdir));  // switch to process's address space
   popcli();
 }
 
+// Refresh the per-process data page of p (see kdata.h).
+void
+setudata(struct proc *p)
+{
+  struct udata *u;
+  pte_t *pte;
+
+  if((pte = walkpgdir(p->pgdir, (char*)UUDATA, 0)) == 0 || !(*pte & PTE_P))
+    panic("setudata");
+  u = (struct udata*)P2V(PTE_ADDR(*pte));
+  if(!p->thread)  // a clone() thread shares its process's page
+    u->pid = p->pid;
+#ifdef CS333_P2
+  u->uid = p->uid;
+  u->gid = p->gid;
+#endif // CS333_P2
+}
+
+// Publish the tick count, and once a second the wall clock, in
+// the shared data page. Called by cpu 0 on each timer interrupt,
+// which makes it the only writer (and the only CMOS reader).
+void
+updatekdata(void)
+{
+  kdata->ticks = ticks;
+  if(ticks % KDATE_TICKS == 0){
+    kdata->dateseq++;
+    __sync_synchronize();
+    cmostime(&kdata->date);
+    __sync_synchronize();
+    kdata->dateseq++;
+  }
+}
+
+// Copy the wall clock last published by updatekdata() into r.
+void
+readkdate(struct rtcdate *r)
+{
+  uint seq;
+
+  do {
+    seq = kdata->dateseq;
+    __sync_synchronize();
+    *r = kdata->date;
+    __sync_synchronize();
+  } while((seq & 1) || seq != kdata->dateseq);
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -224,7 +370,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz > USERTOP)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -278,17 +424,93 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   return newsz;
 }
 
+// Like deallocuvm(), for an address space that threads on other
+// CPUs may be using.  The pages are unmapped first, every CPU's
+// TLB is flushed, and only then are the pages freed, so a stale
+// TLB entry never reaches a page that has been reused.  The
+// physical address stays in each cleared PTE until the free.
+int
+shrinkuvm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  pte_t *pte;
+  uint a;
+
+  if(newsz >= oldsz)
+    return oldsz;
+
+  for(a = PGROUNDUP(newsz); a < oldsz; a += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if(!pte)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else
+      *pte &= ~PTE_P;
+  }
+  tlbshootdown();
+  for(a = PGROUNDUP(newsz); a < oldsz; a += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if(!pte)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if(PTE_ADDR(*pte) != 0){
+      kfree(P2V(PTE_ADDR(*pte)));
+      *pte = 0;
+    }
+  }
+  return newsz;
+}
+
+// Flush the TLB on every CPU and wait until the others have.
+// Callers must not hold a spin lock: a CPU that is waiting for
+// this one with interrupts on must still take its interrupt.
+void
+tlbshootdown(void)
+{
+  struct cpu *c, *me;
+  int others;
+
+  pushcli();
+  me = mycpu();
+  others = 0;
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c != me && c->started){
+      c->tlbwait = 1;
+      others = 1;
+    }
+  }
+  lcr3(rcr3());
+  if(others)
+    lapicipiothers(T_IRQ0 + IRQ_TLB);
+  popcli();
+  for(c = cpus; c < cpus+ncpu; c++)
+    while(c->tlbwait)
+      ;
+}
+
+// Handle the IPI from tlbshootdown().  The flag is cleared first,
+// so a later shootdown that finds it still set waits for a flush
+// that follows its own PTE changes.
+void
+tlbintr(void)
+{
+  mycpu()->tlbwait = 0;
+  lcr3(rcr3());
+}
+
 // Free a page table and all the physical memory pages
-// in the user part.
+// in the user part.  The kernel's page tables are shared
+// (see setupkvm) and stay.
 void
 freevm(pde_t *pgdir)
 {
   uint i;
+  pte_t *pte;
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
+  // The shared kernel data page is not ours to free.
+  if((pte = walkpgdir(pgdir, (char*)UKDATA, 0)) != 0)
+    *pte = 0;
   deallocuvm(pgdir, KERNBASE, 0);
-  for(i = 0; i < NPDENTRIES; i++){
+  for(i = 0; i < PDX(KERNBASE); i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
       kfree(v);
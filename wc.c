@@ -2,47 +2,68 @@
 #include "stat.h"
 #include "user.h"
 
-char buf[512];
+#define SPACE   1
+#define NEWLINE 2
+
+char buf[16384];
+uchar cls[256];  // SPACE and NEWLINE bits for each byte
+int lflag;       // -l: count lines only
 
 void
 wc(int fd, char *name)
 {
-  int i, n;
-  int l, w, c, inword;
+  int i, n, k;
+  int l, w, c, inword, isword;
+  char *p, *e;
 
   l = w = c = 0;
   inword = 0;
   while((n = read(fd, buf, sizeof(buf))) > 0){
-    for(i=0; i<n; i++){
-      c++;
-      if(buf[i] == '\n')
+    c += n;
+    if(lflag){
+      for(p = buf, e = buf+n; (p = memchr(p, '\n', e - p)) != 0; p++)
         l++;
-      if(strchr(" \r\t\n\v", buf[i]))
-        inword = 0;
-      else if(!inword){
-        w++;
-        inword = 1;
-      }
+      continue;
+    }
+    for(i=0; i<n; i++){
+      k = cls[(uchar)buf[i]];
+      l += k >> 1;
+      isword = !(k & SPACE);
+      w += isword & !inword;
+      inword = isword;
     }
   }
   if(n < 0){
     printf(1, "wc: read error\n");
     exit();
   }
-  printf(1, "%d %d %d %s\n", l, w, c, name);
+  if(lflag)
+    printf(1, "%d %s\n", l, name);
+  else
+    printf(1, "%d %d %d %s\n", l, w, c, name);
 }
 
 int
 main(int argc, char *argv[])
 {
   int fd, i;
+  char *s;
+
+  for(s = " \r\t\n\v"; *s; s++)
+    cls[(uchar)*s] = SPACE;
+  cls['\n'] |= NEWLINE;
 
-  if(argc <= 1){
+  i = 1;
+  if(argc > 1 && strcmp(argv[1], "-l") == 0){
+    lflag = 1;
+    i++;
+  }
+  if(i >= argc){
     wc(0, "");
     exit();
   }
 
-  for(i = 1; i < argc; i++){
+  for(; i < argc; i++){
     if((fd = open(argv[i], 0)) < 0){
       printf(1, "wc: cannot open %s\n", argv[i]);
       exit();